@@ -0,0 +1,240 @@
+
+#include <cstdlib>
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <memory_resource>
+#include <numeric>
+#include <vector>
+#include <thread>
+
+#include <boost/program_options.hpp>
+
+#include <cdrc/atomic_rc_ptr.h>
+#include <cdrc/rc_ptr.h>
+
+#include "barrier.hpp"
+
+using namespace std;
+namespace po = boost::program_options;
+
+// Each thread repeatedly builds a short-lived linked list out of rc_ptrs, as if
+// it were handling a request, and then drops it. This measures how much of the
+// cost of such graphs is spent allocating and freeing their nodes. With a size
+// of one, it measures the cost of creating and dropping a single object.
+//
+// Optionally, each request also walks a list by copying an rc_ptr to every node,
+// either its own list, whose nodes were created by the same thread, or the list
+// of the previous request of another thread, to compare the cost of copies made
+// by the thread that owns an object with copies made by other threads.
+
+namespace bench_params {
+  int iterations = 1;
+  double runtime = 1;
+  int threads = 4;
+  int size = 100;
+  string resource = "new";
+  string counter = "split";
+  string copy = "none";
+}
+
+// The layout of the reference counts of the nodes
+enum class CountLayout { packed, split, no_weak, biased };
+
+template<template<typename> typename Backend, CountLayout layout>
+struct Node {
+  using ptr_type = cdrc::rc_ptr<Node, Backend<Node>>;
+  using atomic_ptr_type = cdrc::atomic_rc_ptr<Node, Backend<Node>>;
+
+  Node(int value_, ptr_type next_) : value(value_), next(std::move(next_)) {}
+
+  int value;
+  ptr_type next;
+};
+
+template<template<typename> typename Backend>
+struct cdrc::packed_ref_counts<Node<Backend, CountLayout::packed>> : std::true_type {};
+
+template<template<typename> typename Backend>
+struct cdrc::no_weak<Node<Backend, CountLayout::no_weak>> : std::true_type {};
+
+template<template<typename> typename Backend>
+struct cdrc::biased_ref_counts<Node<Backend, CountLayout::biased>> : std::true_type {};
+
+// Allocates every node with make_shared from the backend's usual allocator
+struct NewAllocation {
+  template<typename T>
+  using backend = cdrc::hp_backend<T>;
+
+  template<typename T, typename... Args>
+  cdrc::rc_ptr<T, backend<T>> make(Args&&... args) {
+    return cdrc::rc_ptr<T, backend<T>>::make_shared(std::forward<Args>(args)...);
+  }
+
+  void end_request() {}
+};
+
+// Allocates every node of a request from a per-thread arena, which is
+// released in one go once the request is complete
+struct ArenaAllocation {
+  template<typename T>
+  using backend = cdrc::hp_pmr_backend<T>;
+
+  ArenaAllocation() : buffer(64 * bench_params::size + 4096), arena(buffer.data(), buffer.size()) {}
+
+  template<typename T, typename... Args>
+  cdrc::rc_ptr<T, backend<T>> make(Args&&... args) {
+    return cdrc::allocate_rc<T>(&arena, std::forward<Args>(args)...);
+  }
+
+  void end_request() { arena.release(); }
+
+  std::vector<std::byte> buffer;
+  std::pmr::monotonic_buffer_resource arena;
+};
+
+// Allocates every node from a per-thread pool resource
+struct PoolAllocation {
+  template<typename T>
+  using backend = cdrc::hp_pmr_backend<T>;
+
+  template<typename T, typename... Args>
+  cdrc::rc_ptr<T, backend<T>> make(Args&&... args) {
+    return cdrc::allocate_rc<T>(&pool, std::forward<Args>(args)...);
+  }
+
+  void end_request() {}
+
+  std::pmr::unsynchronized_pool_resource pool;
+};
+
+template<typename Allocation, CountLayout layout>
+void bench() {
+  using node_type = Node<Allocation::template backend, layout>;
+  using ptr_type = typename node_type::ptr_type;
+  using atomic_ptr_type = typename node_type::atomic_ptr_type;
+
+  for (int i = 0; i < bench_params::iterations; i++) {
+    size_t n_threads = bench_params::threads;
+
+    std::vector<long long int> cnt(n_threads);
+    std::vector<std::thread> threads;
+
+    std::atomic<bool> done = false;
+    Barrier barrier(n_threads+1);
+
+    // The list of the previous request of each thread, for the shared copy mode
+    std::vector<atomic_ptr_type> published(n_threads);
+
+    for (size_t p = 0; p < n_threads; p++) {
+      threads.emplace_back([&barrier, &done, &cnt, &published, p, n_threads]() {
+        Allocation allocation;
+        barrier.wait();
+
+        long long int requests = 0;
+        volatile long long int sum = 0;
+
+        for (; !done; requests++) {
+          ptr_type head;
+          for (int j = 0; j < bench_params::size; j++) {
+            head = allocation.template make<node_type>(j, std::move(head));
+          }
+          if (bench_params::copy == "none") {
+            for (auto node = head.get(); node != nullptr; node = node->next.get()) {
+              sum = sum + node->value;
+            }
+          }
+          else {
+            ptr_type node = head;
+            if (bench_params::copy == "shared") {
+              published[p].store(head);
+              node = published[(p + 1) % n_threads].load();
+            }
+            for (; node != nullptr; node = node->next) {
+              sum = sum + node->value;
+            }
+          }
+          // Drop the list from the front so that its destruction does not recurse
+          while (head) head = std::move(head->next);
+          allocation.end_request();
+        }
+        cnt[p] = requests;
+      });
+    }
+
+    barrier.wait();
+    auto start = std::chrono::high_resolution_clock::now();
+    std::this_thread::sleep_for(std::chrono::duration<double>(bench_params::runtime));
+    done.store(true);
+    for (auto& t : threads) t.join();
+    double elapsed_time = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+    long long int total = std::accumulate(std::begin(cnt), std::end(cnt), 0LL);
+    std::cout << "\tTotal Throughput = " << total * bench_params::size / 1000000.0 / elapsed_time
+              << " Mnodes/s (" << total / elapsed_time << " requests/s) in " << elapsed_time << " second(s)" << std::endl;
+  }
+}
+
+template<typename Allocation>
+void run() {
+  if (bench_params::counter == "packed") bench<Allocation, CountLayout::packed>();
+  else if (bench_params::counter == "split") bench<Allocation, CountLayout::split>();
+  else if (bench_params::counter == "no_weak") bench<Allocation, CountLayout::no_weak>();
+  else if (bench_params::counter == "biased") bench<Allocation, CountLayout::biased>();
+  else {
+    std::cout << "invalid counter layout: " << bench_params::counter << std::endl;
+    exit(1);
+  }
+}
+
+int main(int argc, char* argv[]) {
+  po::options_description description("Usage:");
+
+  description.add_options()
+      ("help,h", "Display this help message")
+      ("threads,t", po::value<int>()->default_value(4), "Number of Threads")
+      ("size,s", po::value<int>()->default_value(100), "Number of nodes allocated by each request")
+      ("runtime,r", po::value<double>()->default_value(0.5), "Runtime of Benchmark (seconds)")
+      ("iterations,i", po::value<int>()->default_value(5), "Number of times to run benchmark")
+      ("resource", po::value<string>()->default_value("new"), "Choose one of: new, arena, pool")
+      ("counter", po::value<string>()->default_value("split"), "Reference count layout, one of: split, packed, no_weak, biased")
+      ("copy", po::value<string>()->default_value("none"), "Walk a list with rc_ptr copies, one of: none, local, shared");
+
+  po::variables_map vm;
+  po::store(po::command_line_parser(argc, argv).options(description).run(), vm);
+  po::notify(vm);
+
+  if (vm.count("help")){
+    cout << description;
+    exit(0);
+  }
+
+  bench_params::iterations = vm["iterations"].as<int>();
+  bench_params::runtime = vm["runtime"].as<double>();
+  bench_params::threads = vm["threads"].as<int>();
+  bench_params::size = vm["size"].as<int>();
+  bench_params::resource = vm["resource"].as<string>();
+  bench_params::counter = vm["counter"].as<string>();
+  bench_params::copy = vm["copy"].as<string>();
+
+  // The lists of other threads must not be allocated from per-thread resources
+  if (bench_params::copy == "shared" && bench_params::resource != "new") {
+    std::cout << "shared copies require the new resource" << std::endl;
+    exit(1);
+  }
+
+  std::cout << "----------------------------------------------------------------" << std::endl;
+  std::cout << "\tChurn benchmark: P = " << bench_params::threads << ", nodes per request = " << bench_params::size
+            << ", resource = " << bench_params::resource << ", counter = " << bench_params::counter
+            << ", copy = " << bench_params::copy << std::endl;
+  std::cout << "--------------------------------------------------------------" << std::endl;
+
+  if (bench_params::resource == "new") run<NewAllocation>();
+  else if (bench_params::resource == "arena") run<ArenaAllocation>();
+  else if (bench_params::resource == "pool") run<PoolAllocation>();
+  else {
+    std::cout << "invalid resource name: " << bench_params::resource << std::endl;
+    exit(1);
+  }
+}
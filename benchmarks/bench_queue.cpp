@@ -1,5 +1,8 @@
 
 #include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
 #include <numeric>
 #include <thread>
 #include <vector>
@@ -7,6 +10,9 @@
 #include <boost/program_options.hpp>
 
 #include <cdrc/internal/smr/acquire_retire_ebr.h>
+#include <cdrc/internal/smr/acquire_retire_hyaline.h>
+#include <cdrc/internal/smr/acquire_retire_ibr.h>
+#include <cdrc/internal/smr/acquire_retire_qsbr.h>
 
 #include "barrier.hpp"
 #include "datastructures/queue.h"
@@ -15,6 +21,52 @@
 using namespace std;
 namespace po = boost::program_options;
 
+// Count the heap allocations performed by each thread so that
+// we can report the number of allocations per operation. Every
+// replaceable form is covered, including the aligned ones used by
+// over-aligned types such as the padded per-thread arrays. They are
+// kept out of line so that GCC does not pair an inlined malloc with
+// a delete expression and warn about a mismatch.
+thread_local size_t num_allocations = 0;
+
+static void* counted_allocate(std::size_t n, std::size_t align) noexcept {
+  num_allocations++;
+  if (n == 0) n = 1;
+  if (align <= alignof(std::max_align_t)) return std::malloc(n);
+  return std::aligned_alloc(align, (n + align - 1) / align * align);
+}
+
+static void* counted_allocate_or_throw(std::size_t n, std::size_t align) {
+  if (void* p = counted_allocate(n, align)) return p;
+  throw std::bad_alloc();
+}
+
+#define COUNTED_NEW __attribute__((noinline))
+
+COUNTED_NEW void* operator new(std::size_t n) { return counted_allocate_or_throw(n, 0); }
+COUNTED_NEW void* operator new[](std::size_t n) { return counted_allocate_or_throw(n, 0); }
+COUNTED_NEW void* operator new(std::size_t n, std::align_val_t a) { return counted_allocate_or_throw(n, static_cast<std::size_t>(a)); }
+COUNTED_NEW void* operator new[](std::size_t n, std::align_val_t a) { return counted_allocate_or_throw(n, static_cast<std::size_t>(a)); }
+COUNTED_NEW void* operator new(std::size_t n, const std::nothrow_t&) noexcept { return counted_allocate(n, 0); }
+COUNTED_NEW void* operator new[](std::size_t n, const std::nothrow_t&) noexcept { return counted_allocate(n, 0); }
+COUNTED_NEW void* operator new(std::size_t n, std::align_val_t a, const std::nothrow_t&) noexcept { return counted_allocate(n, static_cast<std::size_t>(a)); }
+COUNTED_NEW void* operator new[](std::size_t n, std::align_val_t a, const std::nothrow_t&) noexcept { return counted_allocate(n, static_cast<std::size_t>(a)); }
+
+COUNTED_NEW void operator delete(void* p) noexcept { std::free(p); }
+COUNTED_NEW void operator delete[](void* p) noexcept { std::free(p); }
+COUNTED_NEW void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+COUNTED_NEW void operator delete[](void* p, std::size_t) noexcept { std::free(p); }
+COUNTED_NEW void operator delete(void* p, std::align_val_t) noexcept { std::free(p); }
+COUNTED_NEW void operator delete[](void* p, std::align_val_t) noexcept { std::free(p); }
+COUNTED_NEW void operator delete(void* p, std::size_t, std::align_val_t) noexcept { std::free(p); }
+COUNTED_NEW void operator delete[](void* p, std::size_t, std::align_val_t) noexcept { std::free(p); }
+COUNTED_NEW void operator delete(void* p, const std::nothrow_t&) noexcept { std::free(p); }
+COUNTED_NEW void operator delete[](void* p, const std::nothrow_t&) noexcept { std::free(p); }
+COUNTED_NEW void operator delete(void* p, std::align_val_t, const std::nothrow_t&) noexcept { std::free(p); }
+COUNTED_NEW void operator delete[](void* p, std::align_val_t, const std::nothrow_t&) noexcept { std::free(p); }
+
+#undef COUNTED_NEW
+
 template<typename T>
 using our_hp_queue = cdrc::weak_ptr_queue::atomic_queue<T>;
 
@@ -24,6 +76,36 @@ using ebr = cdrc::internal::acquire_retire_ebr<T>;
 template<typename T>
 using our_ebr_queue = cdrc::weak_ptr_queue::atomic_queue<T, ebr>;
 
+template<typename T>
+using ibr = cdrc::internal::acquire_retire_ibr<T>;
+
+template<typename T>
+using our_ibr_queue = cdrc::weak_ptr_queue::atomic_queue<T, ibr>;
+
+template<typename T>
+using hyaline = cdrc::internal::acquire_retire_hyaline<T>;
+
+template<typename T>
+using our_hyaline_queue = cdrc::weak_ptr_queue::atomic_queue<T, hyaline>;
+
+template<typename T>
+using qsbr = cdrc::internal::acquire_retire_qsbr<T>;
+
+template<typename T>
+using our_qsbr_queue = cdrc::weak_ptr_queue::atomic_queue<T, qsbr>;
+
+template<typename T>
+using hp_slab = cdrc::internal::acquire_retire<T, 7, 2, false, cdrc::slab_allocator>;
+
+template<typename T>
+using our_hp_slab_queue = cdrc::weak_ptr_queue::atomic_queue<T, hp_slab>;
+
+template<typename T>
+using ebr_slab = cdrc::internal::acquire_retire_ebr<T, 10, 2, cdrc::slab_allocator>;
+
+template<typename T>
+using our_ebr_slab_queue = cdrc::weak_ptr_queue::atomic_queue<T, ebr_slab>;
+
 #ifdef ARC_JUST_THREADS_AVAILABLE
 template<typename T>
 using jss_queue = cdrc::jss_queue::atomic_queue<T>;
@@ -31,27 +113,38 @@ using jss_queue = cdrc::jss_queue::atomic_queue<T>;
 
 struct NoGuard {};
 
+// Announces a quiescent state at the end of every operation. The main
+// thread goes offline after setup so that it does not hold back reclamation.
+struct QuiescentStateGuard {
+  ~QuiescentStateGuard() { cdrc::quiescent_state(); }
+  static void offline() { cdrc::qsbr_offline(); }
+};
+
 template<template<typename> typename Queue, typename Guard = NoGuard>
 void benchmark_queue(size_t num_threads, size_t num_queues, double runtime, size_t iterations, size_t queue_size) {
   for (size_t it = 1; it <= iterations; it++) {
     std::vector<Queue<int>> queues(num_queues);
     for (size_t i = 0; i < num_queues; i++) {
       for (size_t j = 0; j < queue_size; j++) {
+        [[maybe_unused]] Guard g;
         queues[i].enqueue(j);
       }
     }
+    if constexpr (requires { Guard::offline(); }) Guard::offline();
 
     std::vector<long long int> cnt(num_threads);
+    std::vector<long long int> allocs(num_threads);
     std::vector<std::thread> threads;
 
     std::atomic<bool> done = false;
     Barrier barrier(num_threads+1);
 
     for (size_t t = 0; t < num_threads; t++) {
-      threads.emplace_back([&queues, &barrier, &done, &cnt, t, num_queues]() {
+      threads.emplace_back([&queues, &barrier, &done, &cnt, &allocs, t, num_queues]() {
         cdrc::utils::rand::init(t+1);
         barrier.wait();
         long long int ops = 0;
+        auto allocs_before = num_allocations;
 
         for (; !done; ops++) {
           size_t q_idx1 = cdrc::utils::rand::get_rand() % num_queues;
@@ -65,6 +158,7 @@ void benchmark_queue(size_t num_threads, size_t num_queues, double runtime, size
         }
 
         cnt[t] = ops;
+        allocs[t] = num_allocations - allocs_before;
       });
     }
 
@@ -88,7 +182,9 @@ void benchmark_queue(size_t num_threads, size_t num_queues, double runtime, size
 
     // Read results
     long long int total = std::accumulate(std::begin(cnt), std::end(cnt), 0LL);
+    long long int total_allocs = std::accumulate(std::begin(allocs), std::end(allocs), 0LL);
     std::cout << "\tTotal Throughput = " << total/1000000.0/elapsed_time << " Mop/s in " << elapsed_time << " second(s)" << std::endl;
+    std::cout << "\tAllocations per operation = " << static_cast<double>(total_allocs)/total << std::endl;
   }
 }
 
@@ -101,7 +197,7 @@ int main(int argc, char* argv[]) {
     ("size,s", po::value<int>()->default_value(10), "Number of queues")
     ("runtime,r", po::value<double>()->default_value(0.5), "Runtime of Benchmark (seconds)")
     ("iterations,i", po::value<int>()->default_value(5), "Number of times to run benchmark")
-    ("alg,a", po::value<string>()->default_value("wp"), "Choose one of: dl, wp, sp")
+    ("alg,a", po::value<string>()->default_value("wp"), "Choose one of: dl, wp, wp-epoch, wp-ibr, wp-hyaline, wp-qsbr, wp-slab, wp-epoch-slab")
     ("queue_size", po::value<int>()->default_value(20), "Number of initial elements in each queue");
 
   po::variables_map vm;
@@ -133,6 +229,36 @@ int main(int argc, char* argv[]) {
     vm["runtime"].as<double>(),
     vm["iterations"].as<int>(),
     vm["queue_size"].as<int>());
+  else if (vm["alg"].as<string>() == "wp-ibr") benchmark_queue<our_ibr_queue,cdrc::epoch_guard>(
+    vm["threads"].as<int>(),
+    vm["size"].as<int>(),
+    vm["runtime"].as<double>(),
+    vm["iterations"].as<int>(),
+    vm["queue_size"].as<int>());
+  else if (vm["alg"].as<string>() == "wp-hyaline") benchmark_queue<our_hyaline_queue,cdrc::hyaline_guard>(
+    vm["threads"].as<int>(),
+    vm["size"].as<int>(),
+    vm["runtime"].as<double>(),
+    vm["iterations"].as<int>(),
+    vm["queue_size"].as<int>());
+  else if (vm["alg"].as<string>() == "wp-qsbr") benchmark_queue<our_qsbr_queue,QuiescentStateGuard>(
+    vm["threads"].as<int>(),
+    vm["size"].as<int>(),
+    vm["runtime"].as<double>(),
+    vm["iterations"].as<int>(),
+    vm["queue_size"].as<int>());
+  else if (vm["alg"].as<string>() == "wp-slab") benchmark_queue<our_hp_slab_queue,NoGuard>(
+    vm["threads"].as<int>(),
+    vm["size"].as<int>(),
+    vm["runtime"].as<double>(),
+    vm["iterations"].as<int>(),
+    vm["queue_size"].as<int>());
+  else if (vm["alg"].as<string>() == "wp-epoch-slab") benchmark_queue<our_ebr_slab_queue,cdrc::epoch_guard>(
+    vm["threads"].as<int>(),
+    vm["size"].as<int>(),
+    vm["runtime"].as<double>(),
+    vm["iterations"].as<int>(),
+    vm["queue_size"].as<int>());
 #ifdef ARC_JUST_THREADS_AVAILABLE
   else if (vm["alg"].as<string>() == "jss") benchmark_queue<jss_queue,NoGuard>(
     vm["threads"].as<int>(),
@@ -22,15 +22,39 @@ namespace bench_params{
   int size = 10;
   int store_percent = 10;
   int cas_percent = 0;
+  int hot = 0;
+  bool immortal = false;
   string alg = "gnu";
 }
 
+// Create the objects that the pointers initially hold, which are immortal
+// if requested and supported by the given shared pointer type, which
+// for our implementations is only the case with arc-immortal
+template<template<typename> typename SPType>
+SPType<PaddedInt> make_initial_int(int val) {
+  if (bench_params::immortal) {
+    if constexpr (requires { SPType<PaddedInt>::make_immortal(val); }) {
+      return SPType<PaddedInt>::make_immortal(val);
+    }
+    else {
+      std::cerr << "this algorithm does not support immortal objects" << std::endl;
+      exit(1);
+    }
+  }
+  return make_shared_int<SPType>(val);
+}
+
 template<template<typename> typename AtomicSPType, template<typename> typename SPType>
 struct RefCountBenchmark : Benchmark {
 
+  using smr_traits = SmrTraits<AtomicSPType<PaddedInt>>;
+
   RefCountBenchmark(): Benchmark(), 
                        N(bench_params::size),
                        asp_vec(new cdrc::utils::Padded<AtomicSPType<PaddedInt>>[N]) {
+    for (int i = 0; i < bench_params::hot; i++)
+      hot_objects.push_back(make_initial_int<SPType>(i));
+
     if(N > 100000) {  // initialize in parallel
       size_t n_threads = bench_params::threads;
       assert(n_threads <= cdrc::utils::num_threads());
@@ -41,14 +65,14 @@ struct RefCountBenchmark : Benchmark {
           cdrc::utils::rand::init(p+1);
           size_t chunk_size = N/n_threads + 1;
           for(size_t i = p*chunk_size; i < N && i < (p+1)*chunk_size; i++)
-            asp_vec[i].store(make_shared_int<SPType>(3));
+            asp_vec[i].store(make_initial_int<SPType>(3));
         });        
       }
       for (auto& t : threads) t.join();     
     }
     else { // intialize sequentially 
       for(size_t i = 0; i < N; i++)
-        asp_vec[i].store(make_shared_int<SPType>(3));
+        asp_vec[i].store(make_initial_int<SPType>(3));
     }
   }
 
@@ -77,10 +101,16 @@ struct RefCountBenchmark : Benchmark {
           volatile long long int sum = 0;
           
           for (; !done; ops++) {
+            [[maybe_unused]] typename smr_traits::guard g;
             int op = cdrc::utils::rand::get_rand()%100;
             int asp_index = cdrc::utils::rand::get_rand()%N;
             if(op < bench_params::store_percent){ // store
-              asp_vec[asp_index].store(make_shared_int<SPType>(ops & (1023)));
+              if (bench_params::hot > 0) {  // store one of the shared hot objects
+                SPType<PaddedInt> sp = hot_objects[cdrc::utils::rand::get_rand()%bench_params::hot];
+                asp_vec[asp_index].store(std::move(sp));
+              } else {
+                asp_vec[asp_index].store(make_shared_int<SPType>(ops & (1023)));
+              }
             } else if(op < bench_params::store_percent + bench_params::cas_percent) {  // CAS
               cerr << "not implemented" << endl;
               exit(1);
@@ -137,6 +167,7 @@ struct RefCountBenchmark : Benchmark {
 
   size_t N;
   cdrc::utils::Padded<AtomicSPType<PaddedInt>> *asp_vec;
+  std::vector<SPType<PaddedInt>> hot_objects;
 };
 
 int main(int argc, char* argv[]) {
@@ -149,7 +180,9 @@ int main(int argc, char* argv[]) {
   ("update,u", po::value<int>()->default_value(10), "Percentage of Stores")
   ("runtime,r", po::value<double>()->default_value(0.5), "Runtime of Benchmark (seconds)")
   ("iterations,i", po::value<int>()->default_value(5), "Number of times to run benchmark")
-  ("alg,a", po::value<string>()->default_value("gnu"), "Choose one of: gnu, jss, folly, herlihy, weak_atomic, arc, orc");
+  ("alg,a", po::value<string>()->default_value("gnu"), "Choose one of: gnu, jss, folly, herlihy, weak_atomic, arc, arc-membarrier, arc-ebr, arc-ibr, arc-hyaline, arc-hyaline-s, arc-qsbr, arc-he, arc-wfe, arc-slab, arc-ebr-slab, arc-immortal, orc")
+  ("hot", po::value<int>()->default_value(0), "Store one of this many shared objects instead of a fresh one (0 = always allocate)")
+  ("immortal", po::value<bool>()->default_value(false), "Make the initial and hot objects immortal");
 
 
   po::variables_map vm;
@@ -167,6 +200,8 @@ int main(int argc, char* argv[]) {
   bench_params::threads = vm["threads"].as<int>();
   bench_params::size = vm["size"].as<int>();
   bench_params::store_percent = vm["update"].as<int>();
+  bench_params::hot = vm["hot"].as<int>();
+  bench_params::immortal = vm["immortal"].as<bool>();
 
   run_benchmark<RefCountBenchmark>(bench_params::alg);
 }
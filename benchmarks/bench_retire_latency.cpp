@@ -0,0 +1,205 @@
+
+#include <cstdlib>
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <numeric>
+#include <optional>
+#include <string>
+#include <vector>
+#include <thread>
+
+#include <boost/program_options.hpp>
+
+#include <cdrc/atomic_rc_ptr.h>
+#include <cdrc/background_reclaimer.h>
+#include <cdrc/rc_ptr.h>
+
+#include "barrier.hpp"
+
+using namespace std;
+namespace po = boost::program_options;
+
+// Each thread repeatedly replaces the list in its slot with a new one, and times every
+// replacement. Since the next pointers of the nodes are atomic, destroying a node retires
+// its successor, so dropping a list cascades through the deferred lists of the thread.
+// Optionally, a reader thread periodically sleeps inside a guard, so that a large backlog
+// builds up and becomes safe to eject all at once. This reports the distribution of the
+// latencies of the stores, which include whatever ejects their retires perform. With a
+// background reclaimer, the threads are exempt from reclamation and a separate thread
+// performs their ejects instead.
+
+namespace bench_params {
+  int iterations = 1;
+  double runtime = 1;
+  int threads = 4;
+  int size = 100;
+  size_t budget = 0;
+  size_t time_budget = 0;
+  double stall = 0;
+  bool background = false;
+}
+
+template<size_t budget, size_t time_budget>
+struct Node {
+  using ptr_type = cdrc::rc_ptr<Node, cdrc::ebr_backend<Node>>;
+  using atomic_ptr_type = cdrc::atomic_rc_ptr<Node, cdrc::ebr_backend<Node>>;
+
+  Node(int value_, ptr_type next_) : value(value_), next(std::move(next_)) {}
+
+  int value;
+  atomic_ptr_type next;
+};
+
+template<size_t budget, size_t time_budget>
+struct cdrc::eject_budget<Node<budget, time_budget>> : std::integral_constant<size_t, budget> {};
+
+template<size_t budget, size_t time_budget>
+struct cdrc::eject_time_budget<Node<budget, time_budget>> : std::integral_constant<size_t, time_budget> {};
+
+template<size_t budget, size_t time_budget>
+void bench() {
+  using node_type = Node<budget, time_budget>;
+  using ptr_type = typename node_type::ptr_type;
+  using atomic_ptr_type = typename node_type::atomic_ptr_type;
+
+  for (int i = 0; i < bench_params::iterations; i++) {
+    size_t n_threads = bench_params::threads;
+
+    std::vector<std::vector<uint32_t>> latencies(n_threads);
+    std::vector<std::thread> threads;
+
+    std::atomic<bool> done = false;
+    Barrier barrier(n_threads+1);
+
+    std::vector<atomic_ptr_type> slots(n_threads);
+
+    std::optional<cdrc::background_reclaimer<cdrc::ebr_backend<node_type>>> reclaimer;
+    if (bench_params::background) reclaimer.emplace();
+
+    // The reader alternates between sleeping inside and outside of a guard
+    std::thread reader;
+    if (bench_params::stall > 0) {
+      reader = std::thread([&done, &slots]() {
+        auto stall = std::chrono::duration<double, std::milli>(bench_params::stall);
+        while (!done) {
+          {
+            cdrc::epoch_guard g;
+            [[maybe_unused]] auto s = slots[0].get_snapshot();
+            std::this_thread::sleep_for(stall);
+          }
+          std::this_thread::sleep_for(stall);
+        }
+      });
+    }
+
+    for (size_t p = 0; p < n_threads; p++) {
+      threads.emplace_back([&barrier, &done, &latencies, &slots, p]() {
+        auto& samples = latencies[p];
+        samples.reserve(1 << 20);
+        cdrc::set_reclamation_exempt(bench_params::background);
+        barrier.wait();
+
+        for (int j = 0; !done; j++) {
+          ptr_type head;
+          for (int k = 0; k < bench_params::size; k++) {
+            head = ptr_type::make_shared(k, std::move(head));
+          }
+          cdrc::epoch_guard g;
+          auto start = std::chrono::steady_clock::now();
+          slots[p].store(std::move(head));
+          auto end = std::chrono::steady_clock::now();
+          samples.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+        }
+      });
+    }
+
+    barrier.wait();
+    auto start = std::chrono::high_resolution_clock::now();
+    std::this_thread::sleep_for(std::chrono::duration<double>(bench_params::runtime));
+    done.store(true);
+    for (auto& t : threads) t.join();
+    if (reader.joinable()) reader.join();
+    reclaimer.reset();
+    double elapsed_time = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+    std::vector<uint32_t> all;
+    for (auto& samples : latencies) all.insert(all.end(), samples.begin(), samples.end());
+    std::sort(all.begin(), all.end());
+    auto percentile = [&all](double q) { return all[std::min(all.size() - 1, static_cast<size_t>(q * all.size()))] / 1000.0; };
+
+    std::cout << "\tTotal Throughput = " << all.size() / 1000000.0 / elapsed_time << " Mstores/s in " << elapsed_time << " second(s)" << std::endl;
+    std::cout << "\tStore latency (us): p50 = " << percentile(0.5) << ", p99 = " << percentile(0.99)
+              << ", p99.9 = " << percentile(0.999) << ", max = " << all.back() / 1000.0 << std::endl;
+  }
+}
+
+template<size_t time_budget>
+void bench_with_time_budget() {
+  switch (bench_params::budget) {
+    case 0: bench<0, time_budget>(); break;
+    case 4: bench<4, time_budget>(); break;
+    case 16: bench<16, time_budget>(); break;
+    case 64: bench<64, time_budget>(); break;
+    case 256: bench<256, time_budget>(); break;
+    default:
+      std::cout << "invalid eject budget: " << bench_params::budget << std::endl;
+      exit(1);
+  }
+}
+
+int main(int argc, char* argv[]) {
+  po::options_description description("Usage:");
+
+  description.add_options()
+      ("help,h", "Display this help message")
+      ("threads,t", po::value<int>()->default_value(4), "Number of Threads")
+      ("size,s", po::value<int>()->default_value(100), "Number of nodes in each list")
+      ("runtime,r", po::value<double>()->default_value(0.5), "Runtime of Benchmark (seconds)")
+      ("iterations,i", po::value<int>()->default_value(5), "Number of times to run benchmark")
+      ("budget", po::value<size_t>()->default_value(0), "Eject budget of the nodes, one of: 0 (unbounded), 4, 16, 64, 256")
+      ("time-budget", po::value<size_t>()->default_value(0), "Eject time budget of the nodes in microseconds, one of: 0 (unbounded), 2, 10")
+      ("stall", po::value<double>()->default_value(0), "If nonzero, a reader repeatedly sleeps this many milliseconds inside a guard")
+      ("reclaimer", po::value<std::string>()->default_value("inline"), "Where ejects run, one of: inline, background");
+
+  po::variables_map vm;
+  po::store(po::command_line_parser(argc, argv).options(description).run(), vm);
+  po::notify(vm);
+
+  if (vm.count("help")){
+    cout << description;
+    exit(0);
+  }
+
+  bench_params::iterations = vm["iterations"].as<int>();
+  bench_params::runtime = vm["runtime"].as<double>();
+  bench_params::threads = vm["threads"].as<int>();
+  bench_params::size = vm["size"].as<int>();
+  bench_params::budget = vm["budget"].as<size_t>();
+  bench_params::time_budget = vm["time-budget"].as<size_t>();
+  bench_params::stall = vm["stall"].as<double>();
+
+  auto reclaimer = vm["reclaimer"].as<std::string>();
+  if (reclaimer != "inline" && reclaimer != "background") {
+    std::cout << "invalid reclaimer: " << reclaimer << std::endl;
+    exit(1);
+  }
+  bench_params::background = (reclaimer == "background");
+
+  std::cout << "----------------------------------------------------------------" << std::endl;
+  std::cout << "\tRetire latency benchmark: P = " << bench_params::threads << ", nodes per list = " << bench_params::size
+            << ", budget = " << bench_params::budget << ", time budget = " << bench_params::time_budget << "us"
+            << ", stall = " << bench_params::stall << "ms"
+            << ", reclaimer = " << reclaimer << std::endl;
+  std::cout << "--------------------------------------------------------------" << std::endl;
+
+  switch (bench_params::time_budget) {
+    case 0: bench_with_time_budget<0>(); break;
+    case 2: bench_with_time_budget<2>(); break;
+    case 10: bench_with_time_budget<10>(); break;
+    default:
+      std::cout << "invalid eject time budget: " << bench_params::time_budget << std::endl;
+      exit(1);
+  }
+}
@@ -27,12 +27,14 @@ namespace bench_params {
   size_t stack_size = 20;
   string alg = "gnu";
   bool peek = false;
+  bool stall = false;
 }
 
 template<template<typename> typename AtomicSPType, template<typename> typename SPType>
 struct StackBenchmark : Benchmark {
 
   using stack_type = atomic_stack<int, AtomicSPType, SPType>;
+  using smr_traits = SmrTraits<AtomicSPType<PaddedInt>>;
 
   StackBenchmark(): Benchmark(),
                        N(bench_params::size),
@@ -47,6 +49,7 @@ struct StackBenchmark : Benchmark {
           size_t chunk_size = N/n_threads + 1;
           for(size_t i = p*chunk_size; i < N && i < (p+1)*chunk_size; i++) {
             for (size_t j = 0; j < bench_params::stack_size; j++) {
+              [[maybe_unused]] typename smr_traits::guard g;
               stacks[i].push_front(cdrc::utils::rand::get_rand()%bench_params::stack_size);
             }
           }
@@ -57,9 +60,11 @@ struct StackBenchmark : Benchmark {
     else { // initialize sequentially
       for(size_t i = 0; i < N; i++) {
         for (size_t j = 0; j < bench_params::stack_size; j++) {
+          [[maybe_unused]] typename smr_traits::guard g;
           stacks[i].push_front(cdrc::utils::rand::get_rand()%bench_params::stack_size);
         }
       }
+      smr_traits::offline();
     }
   }
 
@@ -74,6 +79,20 @@ struct StackBenchmark : Benchmark {
       std::atomic<bool> done = false;
       Barrier barrier(n_threads+1);
 
+      // Optionally, have one extra thread read a stack and then sleep for the whole
+      // run while it is still inside its guard, to see how much garbage it pins
+      std::thread staller;
+      std::atomic<bool> stalled = false;
+      if (bench_params::stall) {
+        staller = std::thread([&done, &stalled, this]() {
+          [[maybe_unused]] typename smr_traits::guard g;
+          [[maybe_unused]] auto found = stacks[0].find(0);
+          stalled = true;
+          while (!done) usleep(1000);
+        });
+        while (!stalled) usleep(100);
+      }
+
       for (size_t p = 0; p < n_threads; p++) {
         threads.emplace_back([&barrier, &done, this, &cnt, p]() {
           cdrc::utils::rand::init(p+1);
@@ -84,6 +103,7 @@ struct StackBenchmark : Benchmark {
           long long int sum = 0;
 
           for (; !done; ops++) {
+            [[maybe_unused]] typename smr_traits::guard g;
             int op = cdrc::utils::rand::get_rand()%100;
 
             if(op < bench_params::update_percent){
@@ -131,6 +151,7 @@ struct StackBenchmark : Benchmark {
       done.store(true);
 
       for (auto& t : threads) t.join();
+      if (staller.joinable()) staller.join();
 
 
       // Read results
@@ -144,10 +165,19 @@ struct StackBenchmark : Benchmark {
         std::cout << "\tAverage number of allocated objects: " << avg_alloc << " (" << allocations.size() << " samples)" << std::endl;
         std::cout << "\tMaximum number of allocated objects: " << max_alloc << std::endl;
       }
+      // Once the threads have exited, their deferred decrements have been handed off, so
+      // draining them leaves only the objects that are still in the stacks
+      if constexpr (stack_type::supports_drain) {
+        auto freed = stack_type::drain();
+        std::cout << "\tAllocated objects after drain: " << stack_type::currently_allocated()
+                  << " (" << freed << " freed)" << std::endl;
+      }
       size_t total_nodes = 0;
       for(size_t i = 0; i < N; i++) {
+        [[maybe_unused]] typename smr_traits::guard g;
         total_nodes += stacks[i].size();
       }
+      smr_traits::offline();
       std::cout << "\tTotal stack size = " << total_nodes << std::endl;
     }
   }
@@ -173,9 +203,10 @@ int main(int argc, char* argv[]) {
       ("update,u", po::value<int>()->default_value(10), "Percentage of pushes/pops")
       ("runtime,r", po::value<double>()->default_value(0.5), "Runtime of Benchmark (seconds)")
       ("iterations,i", po::value<int>()->default_value(5), "Number of times to run benchmark")
-      ("alg,a", po::value<string>()->default_value("gnu"), "Choose one of: gnu, jss, folly, herlihy, weak_atomic, arc, orc")
+      ("alg,a", po::value<string>()->default_value("gnu"), "Choose one of: gnu, jss, folly, herlihy, weak_atomic, arc, arc-membarrier, arc-ebr, arc-ibr, arc-hyaline, arc-hyaline-s, arc-qsbr, arc-he, arc-wfe, arc-slab, arc-ebr-slab, orc")
       ("stack_size", po::value<int>()->default_value(20), "Number of initial elements in each stack")
-      ("peek", po::value<bool>()->default_value(false), "Use peek instead of find as the read workload");
+      ("peek", po::value<bool>()->default_value(false), "Use peek instead of find as the read workload")
+      ("stall", po::value<bool>()->default_value(false), "Have an extra thread sleep inside a guard for the whole run");
 
 
   po::variables_map vm;
@@ -195,6 +226,7 @@ int main(int argc, char* argv[]) {
   bench_params::update_percent = vm["update"].as<int>();
   bench_params::peek = vm["peek"].as<bool>();
   bench_params::stack_size = vm["stack_size"].as<int>();
+  bench_params::stall = vm["stall"].as<bool>();
 
   run_benchmark<StackBenchmark>(bench_params::alg);
 }
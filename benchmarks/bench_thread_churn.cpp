@@ -0,0 +1,143 @@
+
+#include <cstdlib>
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <thread>
+
+#include <boost/program_options.hpp>
+
+#include <cdrc/atomic_rc_ptr.h>
+#include <cdrc/rc_ptr.h>
+
+#include "barrier.hpp"
+
+using namespace std;
+namespace po = boost::program_options;
+
+// Runs waves of short-lived threads, as a thread-per-request server would. Each thread
+// replaces the objects in a few shared slots, which retires the objects that it replaced,
+// and then exits. Every wave keeps all of its threads alive until they are done, so they
+// hold distinct thread IDs. Once the waves are over, only the main thread keeps storing.
+//
+// This reports how many objects are still allocated at the end of the waves, and after
+// the main thread has kept storing on its own. Objects that exited threads retired, but
+// could not yet eject, are only freed if the threads that remain adopt them.
+
+namespace bench_params {
+  int iterations = 1;
+  int threads = 8;
+  int waves = 1000;
+  int stores = 20;
+  string alg = "ebr";
+}
+
+template<template<typename> typename Backend>
+struct Node {
+  using ptr_type = cdrc::rc_ptr<Node, Backend<Node>>;
+  using atomic_ptr_type = cdrc::atomic_rc_ptr<Node, Backend<Node>>;
+
+  explicit Node(int value_) : value(value_) {}
+
+  int value;
+};
+
+// Announces a quiescent state at the end of every store for the QSBR backend
+struct QuiescentStateGuard {
+  ~QuiescentStateGuard() { cdrc::quiescent_state(); }
+};
+
+template<template<typename> typename Backend, typename Guard>
+void bench() {
+  using node_type = Node<Backend>;
+  using ptr_type = typename node_type::ptr_type;
+  using atomic_ptr_type = typename node_type::atomic_ptr_type;
+
+  for (int i = 0; i < bench_params::iterations; i++) {
+    size_t n_threads = bench_params::threads;
+    auto before = atomic_ptr_type::currently_allocated();
+
+    std::vector<atomic_ptr_type> slots(n_threads);
+
+    auto start = std::chrono::high_resolution_clock::now();
+    size_t peak = 0;
+    for (int w = 0; w < bench_params::waves; w++) {
+      std::vector<std::thread> threads;
+      Barrier barrier(n_threads);
+      for (size_t p = 0; p < n_threads; p++) {
+        threads.emplace_back([&barrier, &slots, p, n_threads]() {
+          for (int j = 0; j < bench_params::stores; j++) {
+            [[maybe_unused]] Guard g;
+            slots[(p + j) % n_threads].store(ptr_type::make_shared(j));
+          }
+          barrier.wait();
+        });
+      }
+      for (auto& t : threads) t.join();
+      peak = std::max(peak, atomic_ptr_type::currently_allocated() - before);
+    }
+    double elapsed_time = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+    auto after_waves = atomic_ptr_type::currently_allocated() - before;
+
+    // The main thread carries on alone, as a long-lived thread of the server would
+    for (size_t j = 0; j < n_threads * bench_params::stores; j++) {
+      [[maybe_unused]] Guard g;
+      slots[j % n_threads].store(ptr_type::make_shared(j));
+    }
+    auto remaining = atomic_ptr_type::currently_allocated() - before;
+
+    std::cout << "\tTotal Throughput = " << bench_params::waves * n_threads / elapsed_time << " threads/s in "
+              << elapsed_time << " second(s)" << std::endl;
+    std::cout << "\tAllocated objects: peak after a wave = " << peak << ", after the last wave = " << after_waves
+              << ", after the main thread continues = " << remaining << " (" << n_threads << " live)" << std::endl;
+  }
+}
+
+int main(int argc, char* argv[]) {
+  po::options_description description("Usage:");
+
+  description.add_options()
+      ("help,h", "Display this help message")
+      ("threads,t", po::value<int>()->default_value(8), "Number of threads in each wave")
+      ("waves,w", po::value<int>()->default_value(1000), "Number of waves of threads")
+      ("stores,s", po::value<int>()->default_value(20), "Number of stores performed by each thread")
+      ("iterations,i", po::value<int>()->default_value(5), "Number of times to run benchmark")
+      ("alg,a", po::value<string>()->default_value("ebr"), "Choose one of: hp, ebr, ibr, hyaline, qsbr, he, wfe");
+
+  po::variables_map vm;
+  po::store(po::command_line_parser(argc, argv).options(description).run(), vm);
+  po::notify(vm);
+
+  if (vm.count("help")){
+    cout << description;
+    exit(0);
+  }
+
+  bench_params::iterations = vm["iterations"].as<int>();
+  bench_params::threads = vm["threads"].as<int>();
+  bench_params::waves = vm["waves"].as<int>();
+  bench_params::stores = vm["stores"].as<int>();
+  bench_params::alg = vm["alg"].as<string>();
+
+  std::cout << "----------------------------------------------------------------" << std::endl;
+  std::cout << "\tThread churn benchmark: P = " << bench_params::threads << ", waves = " << bench_params::waves
+            << ", stores per thread = " << bench_params::stores << ", alg = " << bench_params::alg << std::endl;
+  std::cout << "--------------------------------------------------------------" << std::endl;
+
+  if (bench_params::alg == "hp") bench<cdrc::hp_backend, cdrc::empty_guard>();
+  else if (bench_params::alg == "ebr") bench<cdrc::ebr_backend, cdrc::epoch_guard>();
+  else if (bench_params::alg == "ibr") bench<cdrc::ibr_backend, cdrc::epoch_guard>();
+  else if (bench_params::alg == "hyaline") bench<cdrc::hyaline_backend, cdrc::hyaline_guard>();
+  else if (bench_params::alg == "qsbr") bench<cdrc::qsbr_backend, QuiescentStateGuard>();
+  else if (bench_params::alg == "he") bench<cdrc::he_backend, cdrc::empty_guard>();
+#if defined(__GCC_HAVE_SYNC_COMPARE_AND_SWAP_16)
+  else if (bench_params::alg == "wfe") bench<cdrc::wfe_backend, cdrc::empty_guard>();
+#endif
+  else {
+    std::cout << "invalid alg name: " << bench_params::alg << std::endl;
+    exit(1);
+  }
+}
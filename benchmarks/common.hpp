@@ -70,6 +70,90 @@ using SnapshottingArcPtr = cdrc::atomic_rc_ptr<T>;
 template<typename T>
 using OurRcPtr = cdrc::rc_ptr<T>;
 
+template<typename T>
+using SnapshottingArcPtrMembarrier = cdrc::atomic_rc_ptr_hp_membarrier<T>;
+
+template<typename T>
+using OurRcPtrMembarrier = cdrc::rc_ptr_hp_membarrier<T>;
+
+template<typename T>
+using SnapshottingArcPtrEbr = cdrc::atomic_rc_ptr_ebr<T>;
+
+template<typename T>
+using OurRcPtrEbr = cdrc::rc_ptr_ebr<T>;
+
+template<typename T>
+using SnapshottingArcPtrIbr = cdrc::atomic_rc_ptr_ibr<T>;
+
+template<typename T>
+using OurRcPtrIbr = cdrc::rc_ptr_ibr<T>;
+
+template<typename T>
+using SnapshottingArcPtrHyaline = cdrc::atomic_rc_ptr_hyaline<T>;
+
+template<typename T>
+using OurRcPtrHyaline = cdrc::rc_ptr_hyaline<T>;
+
+template<typename T>
+using SnapshottingArcPtrHyalineS = cdrc::atomic_rc_ptr_hyaline_s<T>;
+
+template<typename T>
+using OurRcPtrHyalineS = cdrc::rc_ptr_hyaline_s<T>;
+
+template<typename T>
+using SnapshottingArcPtrQsbr = cdrc::atomic_rc_ptr_qsbr<T>;
+
+template<typename T>
+using OurRcPtrQsbr = cdrc::rc_ptr_qsbr<T>;
+
+template<typename T>
+using SnapshottingArcPtrHe = cdrc::atomic_rc_ptr_he<T>;
+
+template<typename T>
+using OurRcPtrHe = cdrc::rc_ptr_he<T>;
+
+#if defined(__GCC_HAVE_SYNC_COMPARE_AND_SWAP_16)
+template<typename T>
+using SnapshottingArcPtrWfe = cdrc::atomic_rc_ptr_wfe<T>;
+
+template<typename T>
+using OurRcPtrWfe = cdrc::rc_ptr_wfe<T>;
+#endif
+
+template<typename T>
+using SlabHpBackend = cdrc::internal::acquire_retire<T, 7, 2, false, cdrc::slab_allocator>;
+
+template<typename T>
+using SnapshottingArcPtrSlab = cdrc::atomic_rc_ptr<T, SlabHpBackend<T>>;
+
+template<typename T>
+using OurRcPtrSlab = cdrc::rc_ptr<T, SlabHpBackend<T>>;
+
+template<typename T>
+using SlabEbrBackend = cdrc::internal::acquire_retire_ebr<T, 10, 2, cdrc::slab_allocator>;
+
+template<typename T>
+using SnapshottingArcPtrEbrSlab = cdrc::atomic_rc_ptr<T, SlabEbrBackend<T>>;
+
+template<typename T>
+using OurRcPtrEbrSlab = cdrc::rc_ptr<T, SlabEbrBackend<T>>;
+
+// Can be made immortal. Meant for bench_ref_count with --immortal, so that
+// the other algorithms do not check whether their objects are immortal
+template<typename T>
+struct ImmortalCounts : T {
+  using T::T;
+};
+
+template<typename T>
+struct cdrc::immortal_objects<ImmortalCounts<T>> : std::true_type {};
+
+template<typename T>
+using SnapshottingArcPtrImmortal = cdrc::atomic_rc_ptr<ImmortalCounts<T>>;
+
+template<typename T>
+using OurRcPtrImmortal = cdrc::rc_ptr<ImmortalCounts<T>>;
+
 template<typename T>
 using HerlihyRcPtr = herlihy_rc_ptr<T, false>;
 
@@ -102,6 +186,8 @@ SPType<PaddedInt> make_shared_int(int val) {
     return herlihy_rc_ptr<PaddedInt, true>::make_shared(val);                             // Herlihy's algorithm
   else if constexpr (std::is_same<SPType<PaddedInt>, cdrc::rc_ptr<PaddedInt>>::value)
     return cdrc::rc_ptr<PaddedInt>::make_shared(val);                                     // Our algorithm
+  else if constexpr (requires { SPType<PaddedInt>::make_shared(val); })
+    return SPType<PaddedInt>::make_shared(val);                                           // Our algorithm with another backend
   else if constexpr (std::is_same<SPType<PaddedInt>, OrcRcPtr<PaddedInt>>::value)   // ORC-GC's "orc_ptr"
     return orcgc_ptp::make_orc<PaddedInt>(val);
   else // homebrew shared pointer [depricated]
@@ -126,6 +212,8 @@ SPType<T> make_shared() {
     return HerlihyRcPtrOpt<T>::make_shared();
   else if constexpr (std::is_same<SPType<T>, cdrc::rc_ptr<T>>::value)
     return cdrc::rc_ptr<T>::make_shared();
+  else if constexpr (requires { SPType<T>::make_shared(); })
+    return SPType<T>::make_shared();
   else if (std::is_same<SPType<PaddedInt>, OrcRcPtr<PaddedInt>>::value)   // ORC-GC's "orc_ptr"
     return orcgc_ptp::make_orc<T>();
   else {
@@ -134,11 +222,61 @@ SPType<T> make_shared() {
   }
 }
 
+// Announces a quiescent state at the end of every operation
+struct QuiescentStateGuard {
+  ~QuiescentStateGuard() { cdrc::quiescent_state(); }
+};
+
+// What a benchmark thread must do to safely operate on a given atomic
+// shared pointer type. Every operation is performed while holding a
+// guard, and a thread that stops operating on the pointers for a while
+// (e.g. the main thread after setup) calls offline().
+template<typename AtomicSP>
+struct SmrTraits {
+  using guard = cdrc::empty_guard;
+  static void offline() { }
+};
+
+template<typename T, size_t epoch_frequency, size_t eject_delay, template<typename> typename Allocator, typename P>
+struct SmrTraits<cdrc::atomic_rc_ptr<T, cdrc::internal::acquire_retire_ebr<T, epoch_frequency, eject_delay, Allocator>, P>> {
+  using guard = cdrc::epoch_guard;
+  static void offline() { }
+};
+
+template<typename T, typename P>
+struct SmrTraits<cdrc::atomic_rc_ptr<T, cdrc::ibr_backend<T>, P>> {
+  using guard = cdrc::epoch_guard;
+  static void offline() { }
+};
+
+template<typename T, typename P>
+struct SmrTraits<cdrc::atomic_rc_ptr<T, cdrc::hyaline_backend<T>, P>> {
+  using guard = cdrc::hyaline_guard;
+  static void offline() { }
+};
+
+template<typename T, typename P>
+struct SmrTraits<cdrc::atomic_rc_ptr<T, cdrc::hyaline_s_backend<T>, P>> {
+  using guard = cdrc::hyaline_guard;
+  static void offline() { }
+};
+
+template<typename T, typename P>
+struct SmrTraits<cdrc::atomic_rc_ptr<T, cdrc::qsbr_backend<T>, P>> {
+  using guard = QuiescentStateGuard;
+  static void offline() { cdrc::qsbr_offline(); }
+};
+
 template<typename T>
 concept AllocationTrackable = requires(T&& t) {
   t.currently_allocated();
 };
 
+template<typename T>
+concept Drainable = requires {
+  T::drain();
+};
+
 // ==================================================================
 //                     Benchmarking framework
 // ==================================================================
@@ -202,6 +340,30 @@ void run_benchmark(std::string alg) {
     run_benchmark_helper<BenchmarkType, herlihy_arc_ptr_opt, HerlihyRcPtrOpt>("Herlihy-Opt");
   else if (alg == "arc")
     run_benchmark_helper<BenchmarkType, SnapshottingArcPtr, OurRcPtr>("ARC");
+  else if (alg == "arc-membarrier")
+    run_benchmark_helper<BenchmarkType, SnapshottingArcPtrMembarrier, OurRcPtrMembarrier>("ARC (membarrier)");
+  else if (alg == "arc-ebr")
+    run_benchmark_helper<BenchmarkType, SnapshottingArcPtrEbr, OurRcPtrEbr>("ARC (EBR)");
+  else if (alg == "arc-ibr")
+    run_benchmark_helper<BenchmarkType, SnapshottingArcPtrIbr, OurRcPtrIbr>("ARC (IBR)");
+  else if (alg == "arc-hyaline")
+    run_benchmark_helper<BenchmarkType, SnapshottingArcPtrHyaline, OurRcPtrHyaline>("ARC (Hyaline)");
+  else if (alg == "arc-hyaline-s")
+    run_benchmark_helper<BenchmarkType, SnapshottingArcPtrHyalineS, OurRcPtrHyalineS>("ARC (Hyaline-S)");
+  else if (alg == "arc-qsbr")
+    run_benchmark_helper<BenchmarkType, SnapshottingArcPtrQsbr, OurRcPtrQsbr>("ARC (QSBR)");
+  else if (alg == "arc-he")
+    run_benchmark_helper<BenchmarkType, SnapshottingArcPtrHe, OurRcPtrHe>("ARC (HE)");
+#if defined(__GCC_HAVE_SYNC_COMPARE_AND_SWAP_16)
+  else if (alg == "arc-wfe")
+    run_benchmark_helper<BenchmarkType, SnapshottingArcPtrWfe, OurRcPtrWfe>("ARC (WFE)");
+#endif
+  else if (alg == "arc-slab")
+    run_benchmark_helper<BenchmarkType, SnapshottingArcPtrSlab, OurRcPtrSlab>("ARC (slab allocator)");
+  else if (alg == "arc-ebr-slab")
+    run_benchmark_helper<BenchmarkType, SnapshottingArcPtrEbrSlab, OurRcPtrEbrSlab>("ARC (EBR, slab allocator)");
+  else if (alg == "arc-immortal")
+    run_benchmark_helper<BenchmarkType, SnapshottingArcPtrImmortal, OurRcPtrImmortal>("ARC (immortal objects)");
   else if (alg == "orc")
     run_benchmark_helper<BenchmarkType, OrcAtomicRcPtr, OrcRcPtr>("ORC-GC");
   else {
@@ -162,6 +162,12 @@ class alignas(64) atomic_stack {
   static std::ptrdiff_t currently_allocated() requires AllocationTrackable<atomic_sp_t> {
     return atomic_sp_t::currently_allocated();
   }
+
+  static constexpr bool supports_drain = Drainable<atomic_sp_t>;
+
+  static size_t drain() requires Drainable<atomic_sp_t> {
+    return atomic_sp_t::drain();
+  }
 };
 
 // Stack specialization for OrcGC, since it unfortunately does not adhere to the C++
@@ -262,6 +268,8 @@ class alignas(64) atomic_stack<T, OrcAtomicRcPtr, OrcRcPtr> {
 
   static std::ptrdiff_t currently_allocated() { return atomic_sp_t::currently_allocated(); }
 
+  static constexpr bool supports_drain = false;
+
 };
 
 
@@ -204,6 +204,17 @@ class atomic_rc_ptr : public pointer_policy::template arc_ptr_policy<T> {
     return mm.currently_allocated();
   }
 
+  // Apply every deferred decrement that the current thread can apply right now, and
+  // return the number of objects that the current thread destroyed. See cdrc::drain.
+  static size_t drain() {
+    return mm.drain();
+  }
+
+  // A snapshot of the statistics of the memory manager. See cdrc::stats.
+  static reclamation_stats stats() {
+    return mm.stats();
+  }
+
  protected:
 
   bool compare_and_swap_impl(counted_ptr_t expected_ptr, counted_ptr_t desired_ptr) noexcept {
@@ -0,0 +1,67 @@
+#ifndef CDRC_BACKGROUND_RECLAIMER_H
+#define CDRC_BACKGROUND_RECLAIMER_H
+
+#include <cstddef>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include "internal/fwd_decl.h"
+#include "internal/memory_manager_base.h"
+
+namespace cdrc {
+
+// Exempt the current thread from reclamation, or make it take part again. An exempt thread
+// never scans announcements or applies deferred actions in its retires, so it never runs
+// the destructors of other objects when it stores or drops a pointer. Instead, it hands its
+// deferred actions off to be applied by the threads that are not exempt, or by a
+// background_reclaimer, one of which must exist for its memory to ever be reclaimed.
+//
+// Hyaline backends free whole batches of objects in whichever thread is the last to leave
+// them, so they do not support exempt threads.
+inline void set_reclamation_exempt(bool exempt = true) {
+  internal::reclamation_exempt() = exempt;
+}
+
+inline bool is_reclamation_exempt() {
+  return internal::reclamation_exempt();
+}
+
+// Runs a thread that periodically applies the deferred actions of the given memory
+// managers, such as cdrc::ebr_backend<T>, including the ones that exempt threads
+// have handed off, until it is destroyed. For example,
+//
+//   cdrc::background_reclaimer<cdrc::ebr_backend<Node>> reclaimer;
+//   cdrc::set_reclamation_exempt();   // in each request-serving thread
+//
+template<typename... MemoryManagers>
+class background_reclaimer {
+ public:
+  explicit background_reclaimer(std::chrono::microseconds period = std::chrono::microseconds(100))
+      : stopping(false), thread([this, period]() { run(period); }) {}
+
+  background_reclaimer(const background_reclaimer&) = delete;
+  background_reclaimer& operator=(const background_reclaimer&) = delete;
+
+  ~background_reclaimer() {
+    stopping.store(true);
+    thread.join();
+  }
+
+ private:
+  void run(std::chrono::microseconds period) {
+    while (!stopping.load()) {
+      (MemoryManagers::instance().reclaim(), ...);
+      std::this_thread::sleep_for(period);
+    }
+    (MemoryManagers::instance().reclaim(), ...);
+  }
+
+  std::atomic<bool> stopping;
+  std::thread thread;
+};
+
+}  // namespace cdrc
+
+#endif  // CDRC_BACKGROUND_RECLAIMER_H
@@ -0,0 +1,31 @@
+#ifndef CDRC_DRAIN_H
+#define CDRC_DRAIN_H
+
+#include <cstddef>
+
+#include "internal/fwd_decl.h"
+#include "internal/memory_manager_base.h"
+
+namespace cdrc {
+
+// Apply every deferred action of the given memory managers that the current thread can
+// apply right now, rather than waiting for enough retires to trigger the next pass, and
+// return the number of objects that the current thread destroyed. This covers the actions
+// of the current thread and those that exempt or exited threads have handed off, and
+// repeats until no more can be applied, advancing the epoch where that helps. The actions
+// of other live threads are still applied by those threads. Objects that another thread
+// ends up destroying, such as a Hyaline batch freed by the last thread to leave its guard,
+// are not counted, so compare currently_allocated() to measure what was reclaimed. Useful
+// at checkpoints, such as after a compaction or before measuring memory, and should be
+// called outside of any guard.
+//
+//   auto freed = cdrc::drain<cdrc::ebr_backend<Node>>();
+//
+template<typename... MemoryManagers>
+size_t drain() {
+  return (size_t{0} + ... + MemoryManagers::instance().drain());
+}
+
+}  // namespace cdrc
+
+#endif  // CDRC_DRAIN_H
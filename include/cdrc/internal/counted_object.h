@@ -4,6 +4,7 @@
 
 
 #include <cassert>
+#include <cstddef>
 #include <cstdint>
 
 #include <atomic>
@@ -14,13 +15,91 @@
 #include "utils.h"
 
 namespace cdrc {
+
+// Objects of type T keep their strong and weak reference counts packed into a single
+// 64-bit word if this is specialized to std::true_type, so that dropping the last strong
+// reference to an object without weak references takes a single atomic update. The word
+// is 8-byte aligned, so this can make the control block larger, such as 16 rather than
+// 12 bytes for an int.
+template<typename T>
+struct packed_ref_counts : std::false_type {};
+
+// Objects of type T have no weak reference count if this is specialized to std::true_type,
+// which makes them smaller and their release cheaper. Weak pointers to T then fail to compile.
+template<typename T>
+struct no_weak : std::false_type {};
+
+// Objects of type T use biased reference counting if this is specialized to std::true_type.
+// Each object is owned by the thread that created it, which updates its own references
+// without atomic read-modify-writes, while other threads update a shared atomic count.
+// This suits objects that are mostly copied and dropped by the thread that created them.
+// Like no_weak, weak pointers to T then fail to compile.
+template<typename T>
+struct biased_ref_counts : std::false_type {};
+
+// Objects of type T can be made immortal with make_immortal if this is specialized to
+// std::true_type. Every update of their reference counts then first checks whether the
+// object is immortal, which costs a load of the count before each read-modify-write, so
+// other types compile the check out. Biased types can not be immortal.
+template<typename T>
+struct immortal_objects : std::false_type {};
+
+// A retire of an object of type T examines at most this many of the deferred actions of
+// its thread, and applies at most this many of those that are no longer protected, if this
+// is specialized to a nonzero value. A pass over the deferred actions then resumes from where
+// the previous retire stopped, and the actions that it finds safe are queued and applied by
+// later retires, which bounds the latency of a store that would otherwise pay for a pass over
+// a long backlog, or whose ejects destroy a long chain of objects. Must be at least 2, so that
+// the passes keep up with the retires and the queue drains. The typical store pays for this:
+// in bench_retire_latency with a stalled reader, a budget of 16 cuts the p99.9 latency of a
+// store from about 3ms to 20us, but raises the median from 0.1us to 4-8us, since most stores
+// then do a share of a pass rather than only the rare store that triggers one.
+// Hyaline backends, which free whole batches at once, ignore it.
+template<typename T>
+struct eject_budget : std::integral_constant<size_t, 0> {};
+
+// A retire of an object of type T stops examining and applying deferred actions once it has
+// spent this many microseconds on them, if this is specialized to a nonzero value, and leaves
+// the rest to later retires as with eject_budget, which can also be set to bound the work
+// by count. The clock is read between slices of a few actions, each of which is finished, so
+// a retire can overrun the budget by a slice, and always does at least one.
+template<typename T>
+struct eject_time_budget : std::integral_constant<size_t, 0> {};
+
+// Bounds the number of deferred actions on objects of type T that are pending in a memory
+// manager if this is specialized with a nonzero soft or hard limit. Past the soft limit, a
+// thread makes a pass over its deferred actions at least once every soft retires, and past
+// the hard limit, on every retire, advancing the epoch first where there is one, and
+// applying every action that the pass finds safe. The hard limit is a ceiling, even while a
+// thread is stalled inside a guard, for the backends that keep freeing what a stalled thread
+// does not protect: hazard pointers, IBR, HE and WFE. If the passes of two retires in a row
+// still leave it exceeded, because a stalled thread protects that many objects, that is
+// reported as a breach. EBR and QSBR, where a stalled thread holds back everything retired
+// since, fail to compile with a hard limit, and Hyaline, which frees whole batches at once,
+// with either limit.
+template<typename T>
+struct deferred_limits {
+  constexpr static size_t soft = 0;
+  constexpr static size_t hard = 0;
+};
+
 namespace internal {
 
 // An instance of an object of type T with an atomic reference count.
 template<typename T>
 struct counted_object {
+  constexpr static bool biased = biased_ref_counts<T>::value;
+  constexpr static bool has_weak_refs = !no_weak<T>::value && !biased;
+  constexpr static bool immortal = immortal_objects<T>::value;
+
+  static_assert(!(immortal && biased), "objects with biased reference counts can not be immortal");
+
+  using counter_type = std::conditional_t<biased, utils::BiasedCounter,
+    std::conditional_t<!has_weak_refs, utils::StrongCounter,
+    std::conditional_t<packed_ref_counts<T>::value, utils::PackedStrongAndWeakCounter, utils::StrongAndWeakCounter<uint32_t>>>>;
+
   alignas(alignof(T)) unsigned char storage[sizeof(T)];
-  utils::StrongAndWeakCounter<uint32_t> counter;
+  counter_type counter;
 
 // In debug mode only, keep track of whether the object has been
 // destroyed yet, to ensure that it is correctly destroyed
@@ -55,6 +134,18 @@ struct counted_object {
 #endif
   }
 
+  // Immortal objects have a strong count of immortal_refs that is never updated,
+  // so any object whose count is at least immortal_threshold is immortal. Such a
+  // count can not be reached by a mortal object in practice. The count is only peeked
+  // at, since the load of a sticky count can write to it.
+  constexpr static uint32_t immortal_refs = uint32_t(3) << 28;
+  constexpr static uint32_t immortal_threshold = uint32_t(1) << 29;
+
+  bool is_immortal() const {
+    if constexpr (!immortal) return false;
+    else return counter.peek_strong(std::memory_order_relaxed) >= immortal_threshold;
+  }
+
   auto get_use_count() const { return counter.load_strong(); }
   auto get_weak_count() const { return counter.load_weak(); }
 
@@ -76,13 +167,14 @@ struct counted_object {
     // https://www.boost.org/doc/libs/1_57_0/doc/html/atomic/usage_examples.html
     // Alternatively, an acquire-release decrement would work, but might be less efficient since the
     // acquire is only relevant if the decrement zeros the counter.
-    if (counter.decrement_strong(count)) {
+    auto result = counter.release_strong(count);
+    if (result != utils::StrongRelease::nonzero) {
       std::atomic_thread_fence(std::memory_order_acquire);
       // If there are no live weak pointers, we can immediately destroy
       // everything. Otherwise, we have to defer the disposal of the
       // managed object since an atomic_weak_ptr might be about to
       // take a snapshot...
-      if (counter.load_weak(std::memory_order_relaxed) == 1) {
+      if (result == utils::StrongRelease::zero_and_no_weak) {
         // Immediately destroy the managed object and
         // collect the control data, since no more
         // live (strong or weak) references exist
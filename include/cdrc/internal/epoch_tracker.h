@@ -55,7 +55,7 @@ struct epoch_tracker {
   // active announcement.
   epoch_type get_min_announced_epoch() {
     epoch_type answer = std::numeric_limits<epoch_type>::max();
-    auto nt = utils::num_threads();
+    auto nt = utils::num_thread_ids();
     for (size_t i = 0; i < nt; i++) {
       answer = std::min(answer, local_epoch[i].load(std::memory_order_acquire));
     }
@@ -66,7 +66,7 @@ struct epoch_tracker {
   template<typename F>
   void scan_announced_epochs(F &&f) {
     std::atomic_thread_fence(std::memory_order_seq_cst); // TODO: is this necessary?
-    auto nt = utils::num_threads();
+    auto nt = utils::num_thread_ids();
     for (size_t i = 0; i < nt; i++) {
       epoch_type e = local_epoch[i].load(std::memory_order_acquire);
       if(e != no_epoch) f(i, e);
@@ -99,11 +99,11 @@ struct epoch_tracker {
   }
 
 private:
-  epoch_tracker() : global_epoch(0), local_epoch(utils::num_threads()), critical_section(utils::num_threads()) {}
+  epoch_tracker() : global_epoch(0) {}
 
   Epoch global_epoch;
-  std::vector <Epoch> local_epoch;
-  std::vector <utils::Padded<bool>> critical_section;
+  utils::PerThreadArray<Epoch> local_epoch;
+  utils::PerThreadArray<utils::Padded<bool>> critical_section;
 };
 
 }  // namespace internal
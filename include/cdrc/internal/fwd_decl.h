@@ -4,10 +4,16 @@
 
 #include <type_traits>
 
+#include "pmr_allocator.h"
 #include "smr/acquire_retire.h"
 #include "smr/acquire_retire_ebr.h"
 #include "smr/acquire_retire_ibr.h"
 #include "smr/acquire_retire_hyaline.h"
+#include "smr/acquire_retire_qsbr.h"
+#include "smr/acquire_retire_he.h"
+#if defined(__GCC_HAVE_SYNC_COMPARE_AND_SWAP_16)
+#include "smr/acquire_retire_wfe.h"
+#endif
 
 namespace cdrc {
 
@@ -137,6 +143,112 @@ template<typename T>
 using weak_snapshot_ptr_hyaline = weak_snapshot_ptr<T, internal::acquire_retire_hyaline<T>>;
 
 
+// Explicit hazard-pointer (asymmetric fence) version of each type
+
+template<typename T>
+using atomic_rc_ptr_hp_membarrier = atomic_rc_ptr<T, internal::acquire_retire_membarrier<T>>;
+
+template<typename T>
+using rc_ptr_hp_membarrier = rc_ptr<T, internal::acquire_retire_membarrier<T>>;
+
+template<typename T>
+using snapshot_ptr_hp_membarrier = snapshot_ptr<T, internal::acquire_retire_membarrier<T>>;
+
+template<typename T>
+using atomic_weak_ptr_hp_membarrier = atomic_weak_ptr<T, internal::acquire_retire_membarrier<T>>;
+
+template<typename T>
+using weak_ptr_hp_membarrier = weak_ptr<T, internal::acquire_retire_membarrier<T>>;
+
+template<typename T>
+using weak_snapshot_ptr_hp_membarrier = weak_snapshot_ptr<T, internal::acquire_retire_membarrier<T>>;
+
+
+// Explicit QSBR version of each type
+
+template<typename T>
+using atomic_rc_ptr_qsbr = atomic_rc_ptr<T, internal::acquire_retire_qsbr<T>>;
+
+template<typename T>
+using rc_ptr_qsbr = rc_ptr<T, internal::acquire_retire_qsbr<T>>;
+
+template<typename T>
+using snapshot_ptr_qsbr = snapshot_ptr<T, internal::acquire_retire_qsbr<T>>;
+
+template<typename T>
+using atomic_weak_ptr_qsbr = atomic_weak_ptr<T, internal::acquire_retire_qsbr<T>>;
+
+template<typename T>
+using weak_ptr_qsbr = weak_ptr<T, internal::acquire_retire_qsbr<T>>;
+
+template<typename T>
+using weak_snapshot_ptr_qsbr = weak_snapshot_ptr<T, internal::acquire_retire_qsbr<T>>;
+
+
+// Explicit hazard eras version of each type
+
+template<typename T>
+using atomic_rc_ptr_he = atomic_rc_ptr<T, internal::acquire_retire_he<T>>;
+
+template<typename T>
+using rc_ptr_he = rc_ptr<T, internal::acquire_retire_he<T>>;
+
+template<typename T>
+using snapshot_ptr_he = snapshot_ptr<T, internal::acquire_retire_he<T>>;
+
+template<typename T>
+using atomic_weak_ptr_he = atomic_weak_ptr<T, internal::acquire_retire_he<T>>;
+
+template<typename T>
+using weak_ptr_he = weak_ptr<T, internal::acquire_retire_he<T>>;
+
+template<typename T>
+using weak_snapshot_ptr_he = weak_snapshot_ptr<T, internal::acquire_retire_he<T>>;
+
+
+#if defined(__GCC_HAVE_SYNC_COMPARE_AND_SWAP_16)
+// Explicit wait-free eras version of each type
+
+template<typename T>
+using atomic_rc_ptr_wfe = atomic_rc_ptr<T, internal::acquire_retire_wfe<T>>;
+
+template<typename T>
+using rc_ptr_wfe = rc_ptr<T, internal::acquire_retire_wfe<T>>;
+
+template<typename T>
+using snapshot_ptr_wfe = snapshot_ptr<T, internal::acquire_retire_wfe<T>>;
+
+template<typename T>
+using atomic_weak_ptr_wfe = atomic_weak_ptr<T, internal::acquire_retire_wfe<T>>;
+
+template<typename T>
+using weak_ptr_wfe = weak_ptr<T, internal::acquire_retire_wfe<T>>;
+
+template<typename T>
+using weak_snapshot_ptr_wfe = weak_snapshot_ptr<T, internal::acquire_retire_wfe<T>>;
+#endif
+
+// Explicit robust Hyaline (Hyaline-S) version of each type
+
+template<typename T>
+using atomic_rc_ptr_hyaline_s = atomic_rc_ptr<T, internal::acquire_retire_hyaline_s<T>>;
+
+template<typename T>
+using rc_ptr_hyaline_s = rc_ptr<T, internal::acquire_retire_hyaline_s<T>>;
+
+template<typename T>
+using snapshot_ptr_hyaline_s = snapshot_ptr<T, internal::acquire_retire_hyaline_s<T>>;
+
+template<typename T>
+using atomic_weak_ptr_hyaline_s = atomic_weak_ptr<T, internal::acquire_retire_hyaline_s<T>>;
+
+template<typename T>
+using weak_ptr_hyaline_s = weak_ptr<T, internal::acquire_retire_hyaline_s<T>>;
+
+template<typename T>
+using weak_snapshot_ptr_hyaline_s = weak_snapshot_ptr<T, internal::acquire_retire_hyaline_s<T>>;
+
+
 // Memory management backend aliases
 
 template<typename T>
@@ -151,6 +263,28 @@ using ibr_backend = internal::acquire_retire_ibr<T>;
 template<typename T>
 using hyaline_backend = internal::acquire_retire_hyaline<T>;
 
+template<typename T>
+using hp_membarrier_backend = internal::acquire_retire_membarrier<T>;
+
+template<typename T>
+using qsbr_backend = internal::acquire_retire_qsbr<T>;
+
+template<typename T>
+using he_backend = internal::acquire_retire_he<T>;
+
+#if defined(__GCC_HAVE_SYNC_COMPARE_AND_SWAP_16)
+template<typename T>
+using wfe_backend = internal::acquire_retire_wfe<T>;
+#endif
+
+template<typename T>
+using hyaline_s_backend = internal::acquire_retire_hyaline_s<T>;
+
+// Hazard-pointer backend whose objects are allocated from std::pmr memory resources
+
+template<typename T>
+using hp_pmr_backend = internal::acquire_retire<T, 7, 2, false, pmr_allocator>;
+
 }  // namespace cdrc
 
 #endif //CDRC_INTERNAL_FWD_DECL_H
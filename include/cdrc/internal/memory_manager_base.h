@@ -4,14 +4,23 @@
 
 #include <cassert>
 #include <cstddef>
+#include <cstdint>
 
+#include <algorithm>
 #include <atomic>
+#include <bit>
+#include <chrono>
+#include <deque>
 #include <functional>
+#include <iterator>
+#include <limits>
 #include <memory>
 #include <type_traits>
+#include <utility>
 #include <vector>
 
 #include "counted_object.h"
+#include "reclamation_stats.h"
 #include "utils.h"
 
 namespace cdrc {
@@ -25,6 +34,14 @@ enum class RetireType {
   dispose
 };
 
+// Whether the current thread is exempt from reclamation. An exempt thread only appends to
+// its deferred lists, and hands them off to the other threads once they are due to be
+// ejected, so it never scans announcements or runs destructors in its retires.
+inline bool& reclamation_exempt() {
+  static thread_local bool exempt = false;
+  return exempt;
+}
+
 template<typename U>
 struct basic_acquired_pointer {
  public:
@@ -66,7 +83,30 @@ struct memory_manager_base {
   using counted_object_t = counted_object<T>;
   using counted_ptr_t = std::add_pointer_t<counted_object_t>;
 
-  explicit memory_manager_base(size_t num_threads) : num_allocated(num_threads) {}
+  // A deferred action on an object packed into a single word. Objects are at least
+  // four-byte aligned, so the retire type is stored in the low bits of the pointer,
+  // which halves the size of the entries of a deferred list.
+  class retired_ptr {
+    static_assert(alignof(counted_object_t) >= 4);
+    constexpr static uintptr_t type_mask = 3;
+
+   public:
+    retired_ptr(counted_ptr_t ptr, RetireType type)
+        : bits(reinterpret_cast<uintptr_t>(ptr) | static_cast<uintptr_t>(type)) {
+      assert((reinterpret_cast<uintptr_t>(ptr) & type_mask) == 0);
+    }
+
+    counted_ptr_t ptr() const { return reinterpret_cast<counted_ptr_t>(bits & ~type_mask); }
+
+    RetireType type() const { return static_cast<RetireType>(bits & type_mask); }
+
+    std::pair<counted_ptr_t, RetireType> unpack() const { return {ptr(), type()}; }
+
+   private:
+    uintptr_t bits;
+  };
+
+  memory_manager_base() = default;
 
   void dispose(counted_ptr_t ptr) {
     assert(ptr->get_use_count() == 0);
@@ -89,7 +129,12 @@ struct memory_manager_base {
   void eject(counted_ptr_t ptr, RetireType type) {
     assert(ptr != nullptr);
 
-    if (type == RetireType::decrement_strong_count) {
+    if constexpr (!counted_object_t::has_weak_refs) {
+      // Objects without weak references are only ever retired to decrement their strong count
+      assert(type == RetireType::decrement_strong_count);
+      decrement_ref_cnt(ptr);
+    }
+    else if (type == RetireType::decrement_strong_count) {
       decrement_ref_cnt(ptr);
     }
     else if (type == RetireType::decrement_weak_count) {
@@ -101,64 +146,931 @@ struct memory_manager_base {
     }
   }
 
-  bool increment_ref_cnt(counted_ptr_t ptr) {
+  // Perform count eject actions of the same type on ptr at once. Decrements
+  // are applied with a single update of the corresponding reference count.
+  void eject(counted_ptr_t ptr, RetireType type, uint64_t count) {
     assert(ptr != nullptr);
-    return ptr->add_refs(1);
+    assert(count >= 1);
+
+    if constexpr (!counted_object_t::has_weak_refs) {
+      assert(type == RetireType::decrement_strong_count);
+      decrement_ref_cnt(ptr, count);
+    }
+    else if (type == RetireType::decrement_strong_count) {
+      decrement_ref_cnt(ptr, count);
+    }
+    else if (type == RetireType::decrement_weak_count) {
+      decrement_weak_cnt(ptr, count);
+    }
+    else {
+      // An object is only ever disposed once
+      assert(type == RetireType::dispose && count == 1);
+      dispose(ptr);
+    }
+  }
+
+  // Perform every eject action in the range [first, last), where key maps each entry
+  // to its (pointer, retire type) pair. Entries that refer to the same object with
+  // the same retire type are coalesced, so a hot object that was retired many times
+  // costs one atomic update rather than one per entry.
+  //
+  // The entries are grouped with a thread-local hash table that is reused by every call.
+  // Grouping costs about as much as an uncontended decrement, so after a pass that finds
+  // few duplicates, the next few passes just eject each entry. Must not be reentered by
+  // the same thread, which the callers already prevent with their in_progress flags since
+  // an eject can cause further retires.
+  template<typename Iterator, typename Key>
+  void eject_coalesced(Iterator first, Iterator last, Key key) {
+    auto id = utils::threadID.getTID();
+    auto& table = coalesce_tables[id];
+    auto n = static_cast<size_t>(std::distance(first, last));
+    count_deferred(-static_cast<std::ptrdiff_t>(n));
+    if (n <= 1 || table.skip_passes > 0) {
+      if (table.skip_passes > 0) table.skip_passes--;
+      for (; first != last; ++first) {
+        auto [ptr, type] = key(*first);
+        eject(ptr, type);
+      }
+    }
+    else {
+      table.begin_pass(n);
+      for (; first != last; ++first) {
+        auto [ptr, type] = key(*first);
+        table.add(ptr, type);
+      }
+      if (4 * table.groups.size() > 3 * n) table.skip_passes = CoalesceTable::passes_to_skip;
+      for (const auto& group : table.groups) eject(group.ptr, group.type, group.count);
+    }
+  }
+
+  // The maximum number of deferred actions that a retire examines, and the maximum number
+  // that it applies, or zero for no limit
+  constexpr static size_t eject_budget = cdrc::eject_budget<T>::value;
+  static_assert(eject_budget == 0 || eject_budget >= 2, "an eject budget must be at least 2");
+
+  // The time in microseconds after which a retire stops examining and applying deferred
+  // actions, or zero for no limit
+  constexpr static size_t eject_time_budget = cdrc::eject_time_budget<T>::value;
+
+  // Whether the retires of the type do a bounded share of each pass, which the backends then
+  // make with a resumable sweep of their deferred lists
+  constexpr static bool bounded_ejects = eject_budget > 0 || eject_time_budget > 0;
+
+  // The number of deferred actions that a retire examines or applies between reads of the
+  // clock, and the limit that stands for no limit on the number examined
+  constexpr static size_t eject_slice = eject_budget > 0 ? std::min<size_t>(eject_budget, 16) : 16;
+  constexpr static size_t unlimited_sweep = std::numeric_limits<size_t>::max();
+
+  // Apply the deferred actions in [first, last), which are no longer protected, where key
+  // maps each entry to its (pointer, retire type) pair. If the ejects of the type are
+  // bounded, the actions are queued instead, and applied a few at a time by apply_queued_ejects.
+  template<typename Iterator, typename Key>
+  void eject_ready(Iterator first, Iterator last, Key key) {
+    if constexpr (!bounded_ejects) {
+      eject_coalesced(first, last, key);
+    }
+    else {
+      auto& queue = eject_queues[utils::threadID.getTID()];
+      for (; first != last; ++first) {
+        auto [ptr, type] = key(*first);
+        queue.entries.emplace_back(ptr, type);
+      }
+    }
+  }
+
+  // Queue the deferred action x, which a resumable sweep found no longer protected, where key
+  // maps it to its (pointer, retire type) pair
+  template<typename Entry, typename Key>
+  void queue_eject(const Entry& x, Key key) {
+    auto [ptr, type] = key(x);
+    eject_queues[utils::threadID.getTID()].entries.emplace_back(ptr, type);
+  }
+
+  // Apply up to limit of the deferred actions queued by the current thread, resuming where the
+  // previous call stopped, and return how many were applied. Does nothing if the ejects of the
+  // type are not bounded, or if the thread is already applying queued actions further up its stack.
+  size_t apply_queued_ejects(size_t limit) {
+    if constexpr (bounded_ejects) {
+      auto& queue = eject_queues[utils::threadID.getTID()];
+      if (queue.in_progress || queue.entries.empty() || reclamation_exempt()) return 0;
+      queue.in_progress = true;
+      auto n = std::min(limit, queue.entries.size());
+      queue.batch.assign(queue.entries.begin(), queue.entries.begin() + n);
+      queue.entries.erase(queue.entries.begin(), queue.entries.begin() + n);
+      eject_coalesced(queue.batch.begin(), queue.batch.end(), [](const auto& x) { return x.unpack(); });
+      queue.in_progress = false;
+      return n;
+    }
+    else return 0;
+  }
+
+  // Apply every deferred action queued by the current thread, regardless of the eject budget,
+  // including any that they queue in turn. Used when the thread exits, since no later retire
+  // of the thread would apply them.
+  void flush_queued_ejects() {
+    if constexpr (bounded_ejects) {
+      auto& queue = eject_queues[utils::threadID.getTID()];
+      if (queue.in_progress) return;
+      queue.in_progress = true;
+      while (!queue.entries.empty()) {
+        queue.batch.assign(queue.entries.begin(), queue.entries.end());
+        queue.entries.clear();
+        eject_coalesced(queue.batch.begin(), queue.batch.end(), [](const auto& x) { return x.unpack(); });
+      }
+      queue.in_progress = false;
+    }
+  }
+
+  // The backends that keep a list of deferred actions per thread share how they schedule the
+  // passes over them. Each provides per-thread in_progress flags, deferred_destructs lists,
+  // eject_work counters, a handed_off list, and eject_deferred(id, limit), which makes one pass
+  // over the list of the thread with the given ID and returns the number of actions it applied.
+  // If the ejects of the type are bounded, a pass is a resumable sweep of the list, of which
+  // eject_deferred examines at most limit entries, and queues the actions that it finds safe.
+
+  // Whether eject_deferred, when asked to examine at most limit entries of the given deferred
+  // list, should resume the sweep of the list that is in progress rather than start a new one.
+  // Only a limited pass resumes a sweep. An unlimited one, as made by drain, stops it, keeping
+  // the entries that it had yet to examine, and starts over with a fresh view of which actions
+  // are protected.
+  template<typename List>
+  static bool resume_sweep(List& list, size_t limit) {
+    if (!list.sweeping()) return false;
+    if (limit != unlimited_sweep) return true;
+    list.stop_sweep();
+    return false;
+  }
+
+  // Called by a retire of the current thread, whose ID is given, once it has appended to its
+  // deferred list. Makes a pass over the list once the thread has retired eject_delay times
+  // the number of threads since the last one, or 30 if that is more. If the ejects of the type
+  // are bounded, the retire instead only does its share of the pass, as eject_within_budget
+  // describes. Past the soft limit on deferred actions, a pass is made every soft_pass_interval
+  // retires however many threads there are, and each retire does twice its share. Past the hard
+  // limit, a pass is made on every retire. These passes first advance the epoch or era of the
+  // backend, and those past the hard limit also apply every action that they find safe,
+  // regardless of the budgets.
+  void work_toward_ejects(size_t id) {
+    auto& self = static_cast<Derived&>(*this);
+    auto pressure = count_retire();
+    auto threshold = std::max<size_t>(30, Derived::eject_delay_per_thread * utils::num_thread_ids());
+    if (pressure == DeferredPressure::hard) threshold = 1;
+    else if (pressure == DeferredPressure::soft) threshold = std::min(soft_pass_interval, soft_deferred_limit);
+    self.eject_work[id] = self.eject_work[id] + 1;
+    if constexpr (bounded_ejects) {
+      if (pressure != DeferredPressure::hard) {
+        bool start_pass = false;
+        if (!self.in_progress[id] && !self.deferred_destructs[id].sweeping() && self.eject_work[id] >= threshold) {
+          self.eject_work[id] = 0;
+          if (hand_off_if_exempt(id)) return;
+          if (pressure != DeferredPressure::none) self.advance_epoch(id);
+          start_pass = true;
+        }
+        eject_within_budget(id, start_pass, pressure == DeferredPressure::soft ? 2 : 1);
+        return;
+      }
+    }
+    while (!self.in_progress[id] && self.eject_work[id] >= threshold) {
+      self.eject_work[id] = 0;
+      if (hand_off_if_exempt(id)) break;
+      if (pressure != DeferredPressure::none) self.advance_epoch(id);
+      self.eject_deferred(id);
+      if (pressure == DeferredPressure::hard) {
+        flush_queued_ejects();
+        check_hard_limit();
+      }
+    }
+  }
+
+  // The share of a retire of the current thread, whose ID is given, in the passes over its
+  // deferred list, for a type whose ejects are bounded. Continues the pass that is in
+  // progress, or starts one if start_pass is set, examining up to scale times eject_budget
+  // of the deferred actions, and then applies up to as many of those that passes have queued.
+  // Without an eject budget, or with a time budget, this is done a slice of eject_slice
+  // actions at a time until the time budget is spent or there is nothing left to do.
+  void eject_within_budget(size_t id, bool start_pass, size_t scale) {
+    auto& self = static_cast<Derived&>(*this);
+    if (self.in_progress[id] || reclamation_exempt()) return;
+    auto examine = eject_budget > 0 ? scale * eject_budget : unlimited_sweep;
+    auto apply = examine;
+    auto deadline = EjectDeadline();
+    bool sweeping = start_pass || self.deferred_destructs[id].sweeping();
+    while (true) {
+      size_t done = 0;
+      if (sweeping && examine > 0) {
+        auto n = std::min(eject_slice, examine);
+        self.eject_deferred(id, n);
+        examine -= n;
+        done += n;
+        sweeping = self.deferred_destructs[id].sweeping();
+      }
+      if (apply > 0) {
+        auto n = apply_queued_ejects(std::min(eject_slice, apply));
+        apply -= n;
+        done += n;
+      }
+      if (done == 0 || deadline.passed()) break;
+    }
+  }
+
+  // The time at which a retire stops examining and applying deferred actions, if the type
+  // has a time budget. Without one, this never reads the clock.
+  struct EjectDeadline {
+    EjectDeadline() {
+      if constexpr (eject_time_budget > 0) end = std::chrono::steady_clock::now() + std::chrono::microseconds(eject_time_budget);
+    }
+
+    bool passed() const {
+      if constexpr (eject_time_budget > 0) return std::chrono::steady_clock::now() >= end;
+      else return false;
+    }
+
+    std::chrono::steady_clock::time_point end;
+  };
+
+  // Advance the epoch or era of the backend right away, for a pass forced by the limits on
+  // deferred actions. The backends that have one hide this.
+  void advance_epoch(size_t) {}
+
+  // If the current thread, whose ID is given, is exempt from reclamation, hand its deferred
+  // actions off to be adopted by the threads that are not, and return true
+  bool hand_off_if_exempt(size_t id) {
+    if (!reclamation_exempt()) return false;
+    hand_off_deferred(id);
+    return true;
+  }
+
+  // Adopt the deferred actions that exempt or exited threads have handed off, and apply
+  // those of the current thread that are no longer protected. This is what a
+  // background_reclaimer calls periodically.
+  void reclaim() {
+    auto& self = static_cast<Derived&>(*this);
+    auto id = utils::threadID.getTID();
+    if (self.in_progress[id]) return;
+    self.eject_deferred(id);
+    apply_queued_ejects(eject_budget > 0 ? eject_budget : unlimited_sweep);
+  }
+
+  // The soft and hard limits on the number of deferred actions pending in this memory
+  // manager, or zero for no limit
+  constexpr static size_t soft_deferred_limit = cdrc::deferred_limits<T>::soft;
+  constexpr static size_t hard_deferred_limit = cdrc::deferred_limits<T>::hard;
+  constexpr static bool limits_deferred = soft_deferred_limit > 0 || hard_deferred_limit > 0;
+
+  // The number of retires between the passes of a thread past the soft limit
+  constexpr static size_t soft_pass_interval = 8;
+  static_assert(soft_deferred_limit == 0 || hard_deferred_limit == 0 || soft_deferred_limit <= hard_deferred_limit,
+    "the soft limit on deferred actions can not exceed the hard limit");
+
+  enum class DeferredPressure { none, soft, hard };
+
+  // The number of times that retires found the soft and hard limits exceeded, and the number
+  // of times that the pass forced by the hard limit failed to bring the count back under it
+  struct DeferredLimitHits {
+    uint64_t soft = 0;
+    uint64_t hard = 0;
+    uint64_t breaches = 0;
+  };
+
+  // Record that the current thread added n deferred actions, or that it removed -n of them if
+  // n is negative. Each thread publishes its count to the shared total once it has changed by
+  // publish_interval, so the total can be off by that much per thread. Does nothing if the
+  // type has no limits.
+  void count_deferred(std::ptrdiff_t n) {
+    if constexpr (limits_deferred) {
+      auto& counts = deferred_counts[utils::threadID.getTID()];
+      counts.own += n;
+      counts.unpublished += n;
+      if (counts.unpublished >= publish_interval || counts.unpublished <= -publish_interval) {
+        pending_deferred.fetch_add(counts.unpublished, std::memory_order_relaxed);
+        counts.unpublished = 0;
+      }
+    }
+  }
+
+  // Record that the current thread retired one more object, and return which of the limits
+  // on deferred actions are now exceeded, counting the hit. A thread whose own count exceeds
+  // a limit sees it exceeded even before it has published its count.
+  DeferredPressure count_retire() {
+    if constexpr (limits_deferred) {
+      count_deferred(1);
+      auto& counts = deferred_counts[utils::threadID.getTID()];
+      auto pending = std::max(pending_deferred.load(std::memory_order_relaxed), counts.own);
+      if (hard_deferred_limit > 0 && pending >= static_cast<std::ptrdiff_t>(hard_deferred_limit)) {
+        counts.hard_hits.store(counts.hard_hits.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        return DeferredPressure::hard;
+      }
+      if (soft_deferred_limit > 0 && pending >= static_cast<std::ptrdiff_t>(soft_deferred_limit)) {
+        counts.soft_hits.store(counts.soft_hits.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        return DeferredPressure::soft;
+      }
+    }
+    return DeferredPressure::none;
+  }
+
+  // Called after the pass that a retire of the current thread made since the hard limit was
+  // exceeded. The pass applied every deferred action that it found safe, but the epoch or era
+  // that it advanced first can still be announced by the guard of a thread, including the
+  // current one, until its next operation. If the pass that the next retire forces still
+  // leaves the limit exceeded, other threads protect that many objects, which in the backends
+  // that bound what a stalled thread protects only happens if it stalled while many objects
+  // that it could reach were retired. That is counted as a breach of the limit, which
+  // deferred_limit_hits reports, rather than as one more hit.
+  void check_hard_limit() {
+    auto& counts = deferred_counts[utils::threadID.getTID()];
+    auto pending = std::max(pending_deferred.load(std::memory_order_relaxed), counts.own);
+    bool exceeded = pending >= static_cast<std::ptrdiff_t>(hard_deferred_limit);
+    if (exceeded && counts.exceeded_after_pass) {
+      counts.breaches.store(counts.breaches.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+    counts.exceeded_after_pass = exceeded;
+  }
+
+  // The number of times that retires have found each of the limits on deferred actions
+  // exceeded, and the number of breaches of the hard limit
+  DeferredLimitHits deferred_limit_hits() {
+    DeferredLimitHits hits;
+    if constexpr (limits_deferred) {
+      for (size_t t = 0; t < utils::num_thread_ids(); t++) {
+        hits.soft += deferred_counts[t].soft_hits.load(std::memory_order_relaxed);
+        hits.hard += deferred_counts[t].hard_hits.load(std::memory_order_relaxed);
+        hits.breaches += deferred_counts[t].breaches.load(std::memory_order_relaxed);
+      }
+    }
+    return hits;
+  }
+
+  // Apply every deferred action that the current thread can apply right now, rather than
+  // waiting for enough retires to trigger the next pass, and return the number of objects
+  // that the current thread destroyed while doing so. Objects that the passes make
+  // reclaimable but another thread destroys, such as a Hyaline batch that a thread still
+  // inside its guard frees when it leaves, are not counted. Each pass calls the backend's
+  // prepare_drain_pass, if it has one, and then its eject_deferred, which applies the
+  // deferred actions of the thread, and those handed off to it, that are no longer
+  // protected. Since applying them can retire further objects, passes are repeated until
+  // one applies nothing. Actions that are still protected by other threads are left in
+  // place. Should be called outside of any guard, since the thread's own guard would
+  // protect the objects that it retired.
+  size_t drain() {
+    auto& self = static_cast<Derived&>(*this);
+    auto tid = utils::threadID.getTID();
+    auto before = num_allocated[tid].destroyed.load(std::memory_order_relaxed);
+    if constexpr (counted_object_t::biased) {
+      auto rec = biased_owner_state().rec;
+      if (rec != nullptr) drain_biased_queue(rec);
+    }
+    while (!self.in_progress[tid]) {
+      self.prepare_drain_pass(tid);
+      auto applied = self.eject_deferred(tid);
+      flush_queued_ejects();
+      if (applied == 0) break;
+    }
+    return static_cast<size_t>(num_allocated[tid].destroyed.load(std::memory_order_relaxed) - before);
+  }
+
+  // Called before each pass of drain. The backends that need to make the actions of the
+  // current thread safe to apply, such as by advancing their epoch, hide this.
+  void prepare_drain_pass(size_t) {}
+
+  // Have the backend's thread_exit run when the current thread exits, so that the deferred
+  // actions that it still holds are handed off to the threads that remain, rather than left
+  // in its slot until another thread reuses its ID. The backends call this on every retire,
+  // and the era-based ones whenever they announce a new era, which after the first call
+  // only checks that the thread-local hook is initialized.
+  void arm_thread_exit_hook() {
+    static thread_local ThreadExitHook hook(static_cast<Derived&>(*this));
+  }
+
+  // Whether any thread has queued deferred actions that are yet to be applied
+  bool any_queued_ejects() {
+    if constexpr (bounded_ejects) {
+      auto nt = utils::num_thread_ids();
+      for (size_t i = 0; i < nt; i++) {
+        if (!eject_queues[i].entries.empty()) return true;
+      }
+    }
+    return false;
+  }
+
+  // Move the deferred actions queued by every thread into out. Used by the destructors
+  // of the backends, which apply every remaining action.
+  void take_queued_ejects(std::vector<std::pair<counted_ptr_t, RetireType>>& out) {
+    if constexpr (bounded_ejects) {
+      auto nt = utils::num_thread_ids();
+      for (size_t i = 0; i < nt; i++) {
+        auto& entries = eject_queues[i].entries;
+        for (const auto& x : entries) out.push_back(x.unpack());
+        entries.clear();
+      }
+    }
+  }
+
+  // Make the current thread the owner of a newly created object whose type
+  // uses biased reference counting. Does nothing for other types.
+  counted_ptr_t adopt_object(counted_ptr_t ptr) {
+    if constexpr (counted_object_t::biased) {
+      auto rec = local_biased_owner();
+      if (rec != nullptr) {
+        drain_biased_queue(rec);
+        ptr->counter.adopt(rec);
+        rec->owned++;
+      }
+    }
+    return ptr;
+  }
+
+  // Make a newly created object immortal. References to it are then copied and dropped
+  // without updating its reference count, and it is destroyed when the program exits.
+  counted_ptr_t make_immortal(counted_ptr_t ptr) {
+    static_assert(counted_object_t::immortal, "only objects whose type specializes immortal_objects can be immortal");
+    ptr->add_refs(counted_object_t::immortal_refs - 1);
+    immortals.push(ptr);
+    return ptr;
+  }
+
+  // Release the immortal objects, and return whether there were any. Deferred actions can
+  // still refer to immortal objects, so the destructor of each backend calls this once it
+  // has applied all of them, and then applies the ones that destroying the objects deferred.
+  bool release_immortals() {
+    if constexpr (!counted_object_t::immortal) return false;
+    else {
+      auto node = immortals.take_all();
+      if (node == nullptr) return false;
+      while (node != nullptr) {
+        auto next = node->next;
+        release_strong_refs(node->ptr, counted_object_t::immortal_refs);
+        delete node;
+        node = next;
+      }
+      return true;
+    }
+  }
+
+  bool increment_ref_cnt(counted_ptr_t ptr, uint64_t count = 1) {
+    assert(ptr != nullptr);
+    if constexpr (counted_object_t::biased) {
+      auto rec = biased_owner_state().rec;
+      if (rec != nullptr && ptr->counter.is_owned_by(rec)) ptr->counter.increment_owned(count);
+      else ptr->counter.increment_shared(count);
+      return true;
+    }
+    else {
+      if (ptr->is_immortal()) return true;
+      return ptr->add_refs(count);
+    }
   }
 
   bool increment_weak_cnt(counted_ptr_t ptr) {
+    static_assert(counted_object_t::has_weak_refs, "weak pointers can not refer to objects whose type has no weak reference count");
     assert(ptr != nullptr);
     return ptr->add_weak_refs(1);
   }
 
-  void decrement_ref_cnt(counted_ptr_t ptr) {
+  void decrement_ref_cnt(counted_ptr_t ptr, uint64_t count = 1) {
     assert(ptr != nullptr);
-    assert(ptr->get_use_count() >= 1);
-    auto result = ptr->release_refs(1);
-    if (result == counted_object_t::EjectAction::destroy) {
-      destroy(ptr);
-    } else if (result == counted_object_t::EjectAction::delay) {
-      retire(ptr, RetireType::dispose);
+    if constexpr (counted_object_t::biased) {
+      decrement_biased_ref_cnt(ptr, count);
+    }
+    else {
+      if (ptr->is_immortal()) return;
+      release_strong_refs(ptr, count);
     }
   }
 
-  void decrement_weak_cnt(counted_ptr_t ptr) {
+  void decrement_weak_cnt(counted_ptr_t ptr, uint64_t count = 1) {
+    static_assert(counted_object_t::has_weak_refs, "weak pointers can not refer to objects whose type has no weak reference count");
     assert(ptr != nullptr);
-    assert(ptr->get_weak_count() >= 1);
-    if (ptr->release_weak_refs(1)) {
+    assert(ptr->get_weak_count() >= count);
+    if (ptr->release_weak_refs(count)) {
       destroy(ptr);
     }
   }
 
   void delayed_decrement_ref_cnt(counted_ptr_t ptr) {
     assert(ptr->get_use_count() >= 1);
+    if (ptr->is_immortal()) return;
     retire(ptr, RetireType::decrement_strong_count);
   }
 
   void delayed_decrement_weak_cnt(counted_ptr_t ptr) {
+    static_assert(counted_object_t::has_weak_refs, "weak pointers can not refer to objects whose type has no weak reference count");
     assert(ptr->get_weak_count() >= 1);
     retire(ptr, RetireType::decrement_weak_count);
   }
 
+  // Each count of allocations is only updated by its own thread, so it needs no ordering
+  // beyond the release that pairs with the acquire in currently_allocated
   void decrement_allocations() {
-    int tid = utils::threadID.getTID();
-    num_allocated[tid].store(num_allocated[tid].load(std::memory_order_seq_cst) - 1, std::memory_order_seq_cst);
+    auto& count = num_allocated[utils::threadID.getTID()].destroyed;
+    count.store(count.load(std::memory_order_relaxed) + 1, std::memory_order_release);
   }
 
   void increment_allocations() {
-    int tid = utils::threadID.getTID();
-    num_allocated[tid].store(num_allocated[tid].load(std::memory_order_seq_cst) + 1, std::memory_order_seq_cst);
+    auto& count = num_allocated[utils::threadID.getTID()].created;
+    count.store(count.load(std::memory_order_relaxed) + 1, std::memory_order_release);
   }
 
   size_t currently_allocated() {
-    size_t total = 0;
-    for (size_t t = 0; t < utils::num_threads(); t++) {
-      total += num_allocated[t].load(std::memory_order_acquire);
+    uint64_t total = 0;
+    for (size_t t = 0; t < utils::num_thread_ids(); t++) {
+      // An object can be destroyed by a different thread than the one that created it, so
+      // the count of a single thread can be negative, and wraps around until summed
+      total += num_allocated[t].created.load(std::memory_order_acquire);
+      total -= num_allocated[t].destroyed.load(std::memory_order_acquire);
+    }
+    return static_cast<size_t>(total);
+  }
+
+  // The methods that record statistics do nothing unless CDRC_STATS is defined. Nothing is
+  // recorded per retire or per eject. Instead, the retires of a thread are counted from how
+  // much its deferred actions grew since they were last counted, by its passes, its batches,
+  // and cdrc::stats, and its ejects from how many deferred actions its passes removed or its
+  // batches applied.
+
+  // Count the retires of the current thread, whose ID is given, that are held in its deferred
+  // actions and yet to be counted. Backends that hold them other than in deferred_destructs
+  // lists hide this.
+  void count_held_retires([[maybe_unused]] size_t id) {
+    count_retires(id, static_cast<Derived&>(*this).deferred_destructs[id].size());
+  }
+
+  // Count the retires of the thread with the given ID, which must be the current thread, as
+  // the growth of its deferred actions, of which it now holds the given number, since they
+  // were last counted
+  void count_retires([[maybe_unused]] size_t id, [[maybe_unused]] size_t deferred) {
+    if constexpr (stats_enabled) thread_stats[id].count_retires(deferred);
+  }
+
+  // Record that the given number of deferred actions that the thread with the given ID, which
+  // must be the current thread, adopted from other threads, were already counted as retires
+  void skip_retires([[maybe_unused]] size_t id, [[maybe_unused]] size_t adopted) {
+    if constexpr (stats_enabled) thread_stats[id].counted_deferred += adopted;
+  }
+
+  // Hand the deferred list of the current thread, whose ID is given, off to be adopted by
+  // other threads, once its retires have been counted
+  void hand_off_deferred(size_t id) {
+    auto& self = static_cast<Derived&>(*this);
+    if constexpr (stats_enabled) thread_stats[id].count_released(self.deferred_destructs[id].size());
+    self.deferred_destructs[id].hand_off(self.handed_off);
+  }
+
+  // Record that the current thread, whose ID is given, added its partial batch of the given
+  // number of deferred actions, or handed it off to other threads
+  void record_batch([[maybe_unused]] size_t id, [[maybe_unused]] size_t deferred) {
+    if constexpr (stats_enabled) {
+      if (batch_stats.release(deferred)) publish_batch_stats(id);
+    }
+  }
+
+  // Record that the current thread applied the given number of deferred actions of a batch.
+  // A thread that only reads can apply batches, so this arms its exit hook, which publishes.
+  void record_batch_ejects([[maybe_unused]] uint64_t applied) {
+    if constexpr (stats_enabled) {
+      arm_thread_exit_hook();
+      if (batch_stats.apply(applied)) publish_batch_stats(utils::threadID.getTID());
+    }
+  }
+
+  // Record that the given number of deferred actions that the current thread adopted into its
+  // partial batch from other threads were already counted as retires
+  void skip_batch_retires([[maybe_unused]] size_t adopted) {
+    if constexpr (stats_enabled) batch_stats.counted += adopted;
+  }
+
+  // Count the retires of the current thread, whose ID is given, as the growth of its partial
+  // batch, which now holds the given number of deferred actions, and publish them
+  void count_batch_retires([[maybe_unused]] size_t id, [[maybe_unused]] size_t deferred) {
+    if constexpr (stats_enabled) {
+      batch_stats.count_retires(deferred);
+      publish_batch_stats(id);
+    }
+  }
+
+  // Add the batch statistics of the current thread, whose ID is given, to its statistics
+  void publish_batch_stats([[maybe_unused]] size_t id) {
+    if constexpr (stats_enabled) batch_stats.publish(thread_stats[id]);
+  }
+
+  // Called at the start and the end of a pass over the deferred actions of the thread with
+  // the given ID, which holds the given number of them at the start. The start of the pass
+  // counts the retires since they were last counted, and records the high-water mark, since
+  // deferred actions are only removed by passes. The end of the pass counts the deferred
+  // actions that it removed as ejects, including those that an eject budget queues.
+  PassStats begin_pass([[maybe_unused]] size_t id, [[maybe_unused]] size_t deferred) {
+    if constexpr (stats_enabled) {
+      auto& stats = thread_stats[id];
+      stats.count_retires(deferred);
+      stats.deferred_high_water.raise_to(deferred);
+      return PassStats(stats);
+    }
+    else return PassStats();
+  }
+
+  void end_pass([[maybe_unused]] const PassStats& pass, [[maybe_unused]] size_t removed) {
+    if constexpr (stats_enabled) pass.finish(removed);
+  }
+
+  // Record that a snapshot took a reference to its object since no snapshot slot was free
+  void record_snapshot_overflow() {
+    if constexpr (stats_enabled) thread_stats[utils::threadID.getTID()].snapshot_slot_overflows.add(1);
+  }
+
+  void record_epoch_advance([[maybe_unused]] size_t id) {
+    if constexpr (stats_enabled) thread_stats[id].epoch_advances.add(1);
+  }
+
+  // A snapshot of the statistics of this memory manager. See cdrc::stats.
+  reclamation_stats stats() {
+    reclamation_stats result;
+    // The retires of the calling thread are counted right away, unless it is in a pass
+    auto& self = static_cast<Derived&>(*this);
+    auto tid = utils::threadID.getTID();
+    if (!self.in_progress[tid]) self.count_held_retires(tid);
+    for (size_t t = 0; t < utils::num_thread_ids(); t++) {
+      if constexpr (stats_enabled) thread_stats[t].collect(result);
+      result.creates += num_allocated[t].created.load(std::memory_order_acquire);
+      result.destroys += num_allocated[t].destroyed.load(std::memory_order_acquire);
+    }
+    auto hits = deferred_limit_hits();
+    result.soft_limit_hits = hits.soft;
+    result.hard_limit_hits = hits.hard;
+    result.hard_limit_breaches = hits.breaches;
+    return result;
+  }
+
+  // The number of objects that a thread created and the number that it destroyed, which
+  // give both the number currently allocated and the statistics of cdrc::stats
+  struct alignas(128) AllocationCount {
+    std::atomic<uint64_t> created{0};
+    std::atomic<uint64_t> destroyed{0};
+  };
+
+  utils::PerThreadArray<AllocationCount> num_allocated;
+
+ private:
+  // The owner of objects that use biased reference counting, one per thread that creates
+  // them. Objects whose shared count went negative are pushed onto its queue, and the owner
+  // merges their counts the next time it creates an object or gives up an object. When the
+  // thread exits, it merges the objects in its queue and closes it, after which the threads
+  // that would queue an object merge it themselves. Since objects refer to their owner, the
+  // record is reference counted by its thread and by the objects that are still owned.
+  struct BiasedOwner {
+    std::atomic<counted_ptr_t> queue{nullptr};
+    std::atomic<std::ptrdiff_t> refs{1};
+    size_t owned{0};                                     // Only accessed by the owning thread
+  };
+
+  struct BiasedOwnerState {
+    BiasedOwner* rec = nullptr;
+    bool exited = false;
+  };
+
+  // Closes the owner record of the current thread when the thread exits
+  struct BiasedOwnerHandle {
+    explicit BiasedOwnerHandle(memory_manager_base& mm_) : mm(mm_) {
+      biased_owner_state().rec = new BiasedOwner;
+    }
+    ~BiasedOwnerHandle() { mm.close_biased_owner(); }
+    memory_manager_base& mm;
+  };
+
+  struct ThreadExitHook {
+    explicit ThreadExitHook(Derived& mm_) : mm(mm_) {
+      // The thread ID is used by thread_exit, so it must outlive the hook
+      utils::threadID.getTID();
     }
-    return total;
+    ~ThreadExitHook() { mm.thread_exit(); }
+    Derived& mm;
+  };
+
+  static counted_ptr_t closed_biased_queue() { return reinterpret_cast<counted_ptr_t>(uintptr_t(1)); }
+
+  static BiasedOwnerState& biased_owner_state() {
+    static thread_local BiasedOwnerState state;
+    return state;
+  }
+
+  // The owner record of the current thread, which is created on first use. Returns
+  // nullptr once the thread is exiting, in which case new objects stay unowned.
+  BiasedOwner* local_biased_owner() {
+    auto& state = biased_owner_state();
+    if (state.rec == nullptr && !state.exited) {
+      // The thread ID is used by the destruction of objects, so it must outlive the handle
+      utils::threadID.getTID();
+      static thread_local BiasedOwnerHandle handle(*this);
+    }
+    return state.rec;
+  }
+
+  static BiasedOwner* owner_of(counted_ptr_t ptr) {
+    return static_cast<BiasedOwner*>(const_cast<void*>(ptr->counter.get_owner()));
+  }
+
+  static counted_ptr_t next_in_queue(counted_ptr_t ptr) {
+    return static_cast<counted_ptr_t>(const_cast<void*>(ptr->counter.get_owner()));
+  }
+
+  void release_biased_owner(BiasedOwner* rec, std::ptrdiff_t count) {
+    if (rec->refs.fetch_sub(count, std::memory_order_acq_rel) == count) delete rec;
+  }
+
+  void destroy_biased(counted_ptr_t ptr) {
+    std::atomic_thread_fence(std::memory_order_acquire);
+    ptr->dispose();
+    destroy(ptr);
   }
 
-  std::vector<utils::Padded<std::atomic<std::ptrdiff_t>>> num_allocated;
+  void release_strong_refs(counted_ptr_t ptr, uint64_t count) {
+    assert(ptr->get_use_count() >= count);
+    auto result = ptr->release_refs(count);
+    if (result == counted_object_t::EjectAction::destroy) {
+      destroy(ptr);
+    } else if constexpr (counted_object_t::has_weak_refs) {
+      if (result == counted_object_t::EjectAction::delay) retire(ptr, RetireType::dispose);
+    }
+  }
+
+  // The immortal objects of this memory manager, which are released by release_immortals
+  class ImmortalList {
+   public:
+    struct Node {
+      counted_ptr_t ptr;
+      Node* next;
+    };
+
+    ImmortalList() : head(nullptr) {}
+
+    ImmortalList(const ImmortalList&) = delete;
+    ImmortalList& operator=(const ImmortalList&) = delete;
+
+    ~ImmortalList() { assert(head.load() == nullptr); }
+
+    void push(counted_ptr_t ptr) {
+      auto node = new Node{ptr, head.load(std::memory_order_relaxed)};
+      while (!head.compare_exchange_weak(node->next, node, std::memory_order_release, std::memory_order_relaxed)) {}
+    }
+
+    // Remove every node from the list, and return the first of them
+    Node* take_all() { return head.exchange(nullptr, std::memory_order_acquire); }
+
+   private:
+    std::atomic<Node*> head;
+  };
+
+  void decrement_biased_ref_cnt(counted_ptr_t ptr, uint64_t count) {
+    auto rec = biased_owner_state().rec;
+    utils::BiasedRelease result;
+    if (rec != nullptr && ptr->counter.is_owned_by(rec)) {
+      result = ptr->counter.decrement_owned(count);
+      if (result != utils::BiasedRelease::nonzero) {
+        rec->owned--;
+        drain_biased_queue(rec);
+      }
+    }
+    else {
+      result = ptr->counter.decrement_shared(count);
+      if (result == utils::BiasedRelease::queue) {
+        queue_to_owner(ptr);
+        return;
+      }
+    }
+    if (result == utils::BiasedRelease::zero) destroy_biased(ptr);
+  }
+
+  // Push an object whose shared count went negative onto the queue of its owner,
+  // or merge it right away if the owner has exited
+  void queue_to_owner(counted_ptr_t ptr) {
+    auto rec = owner_of(ptr);
+    auto head = rec->queue.load(std::memory_order_acquire);
+    do {
+      if (head == closed_biased_queue()) {
+        auto result = ptr->counter.merge();
+        release_biased_owner(rec, 1);
+        if (result == utils::BiasedRelease::zero) destroy_biased(ptr);
+        return;
+      }
+      ptr->counter.set_next(head);
+    } while (!rec->queue.compare_exchange_weak(head, ptr, std::memory_order_release, std::memory_order_acquire));
+  }
+
+  // Merge the counts of the objects queued to the given owner, which must be the current thread's
+  void drain_biased_queue(BiasedOwner* rec) {
+    if (rec->queue.load(std::memory_order_relaxed) == nullptr) return;
+    auto ptr = rec->queue.exchange(nullptr, std::memory_order_acquire);
+    while (ptr != nullptr) {
+      auto next = next_in_queue(ptr);
+      rec->owned--;
+      if (ptr->counter.merge() == utils::BiasedRelease::zero) destroy_biased(ptr);
+      ptr = next;
+    }
+  }
+
+  void close_biased_owner() {
+    auto& state = biased_owner_state();
+    auto rec = state.rec;
+    // Objects destroyed from here on are released through the shared count
+    state.rec = nullptr;
+    state.exited = true;
+    rec->refs.fetch_add(rec->owned, std::memory_order_relaxed);
+    auto ptr = rec->queue.exchange(closed_biased_queue(), std::memory_order_acq_rel);
+    while (ptr != nullptr) {
+      auto next = next_in_queue(ptr);
+      auto result = ptr->counter.merge();
+      release_biased_owner(rec, 1);
+      if (result == utils::BiasedRelease::zero) destroy_biased(ptr);
+      ptr = next;
+    }
+    release_biased_owner(rec, 1);
+  }
+
+  // An open-addressed hash table from (pointer, retire type) to the number of times
+  // that it was added. Slots are stamped with the pass that filled them, so that the
+  // table never needs to be cleared, and the distinct keys are kept in a dense list.
+  struct alignas(128) CoalesceTable {
+    // How many passes to skip after one where at least 3/4 of the entries were distinct
+    constexpr static uint32_t passes_to_skip = 8;
+
+    struct Group {
+      counted_ptr_t ptr;
+      RetireType type;
+      uint64_t count;
+    };
+
+    struct Slot {
+      uint32_t pass = 0;
+      uint32_t group = 0;
+    };
+
+    void begin_pass(size_t n) {
+      groups.clear();
+      // At least twice as many slots as keys keeps the probe sequences short
+      size_t size = std::bit_ceil(2 * n);
+      if (slots.size() < size || ++pass == 0) {
+        slots.assign(std::max(size, slots.size()), Slot{});
+        pass = 1;
+      }
+      mask = size - 1;
+    }
+
+    void add(counted_ptr_t ptr, RetireType type) {
+      auto h = (reinterpret_cast<uintptr_t>(ptr) >> 4) * 0x9E3779B97F4A7C15ULL + static_cast<uintptr_t>(type);
+      for (size_t i = (h >> 32) & mask;; i = (i + 1) & mask) {
+        auto& slot = slots[i];
+        if (slot.pass != pass) {
+          slot = Slot{pass, static_cast<uint32_t>(groups.size())};
+          groups.push_back(Group{ptr, type, 1});
+          return;
+        }
+        auto& group = groups[slot.group];
+        if (group.ptr == ptr && group.type == type) {
+          group.count++;
+          return;
+        }
+      }
+    }
+
+    std::vector<Slot> slots;
+    std::vector<Group> groups;
+    uint32_t pass = 0;
+    uint32_t skip_passes = 0;
+    size_t mask = 0;
+  };
+
+  // The deferred actions of a thread that are known to be safe to apply, but were held
+  // back by the eject budget, in the order that they were found to be safe
+  struct alignas(128) EjectQueue {
+    std::deque<retired_ptr> entries;
+    std::vector<retired_ptr> batch;
+    bool in_progress = false;
+  };
+
+  // The smallest nonzero limit on deferred actions, which sets how often threads publish their counts
+  constexpr static size_t smallest_deferred_limit =
+    soft_deferred_limit > 0 ? soft_deferred_limit : hard_deferred_limit;
+  constexpr static std::ptrdiff_t publish_interval =
+    static_cast<std::ptrdiff_t>(std::clamp<size_t>(smallest_deferred_limit / 64, 1, 64));
+
+  // The number of deferred actions that a thread added less the number that it applied, the
+  // part of that change that is yet to be published, and the number of times that its
+  // retires found the limits exceeded or breached the hard limit, and whether its last pass
+  // forced by the hard limit left it exceeded
+  struct alignas(128) DeferredCounts {
+    std::ptrdiff_t own = 0;
+    std::ptrdiff_t unpublished = 0;
+    bool exceeded_after_pass = false;
+    std::atomic<uint64_t> soft_hits{0};
+    std::atomic<uint64_t> hard_hits{0};
+    std::atomic<uint64_t> breaches{0};
+  };
+
+  utils::PerThreadArray<CoalesceTable> coalesce_tables;    // Thread-local tables for grouping ejects, reused by every eject
+  utils::PerThreadArray<EjectQueue> eject_queues;          // Thread-local queues of ejects held back by the eject budget
+  utils::PerThreadArray<DeferredCounts> deferred_counts;   // Thread-local counts of deferred actions, for the deferred limits
+  ImmortalList immortals;                                  // The immortal objects, released when the backend is destroyed
+  alignas(128) std::atomic<std::ptrdiff_t> pending_deferred{0};  // The published number of pending deferred actions
+  [[no_unique_address]] PerThreadStats thread_stats;      // Thread-local statistics, which take no space without CDRC_STATS
+  inline static thread_local BatchStats batch_stats;      // Statistics of batches of the current thread yet to be published
 };
 
 }  // namespace internal
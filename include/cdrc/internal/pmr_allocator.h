@@ -0,0 +1,82 @@
+#ifndef CDRC_INTERNAL_PMR_ALLOCATOR_H
+#define CDRC_INTERNAL_PMR_ALLOCATOR_H
+
+#include <cstddef>
+
+#include <algorithm>
+#include <memory_resource>
+#include <new>
+#include <utility>
+
+namespace cdrc {
+
+namespace internal {
+
+// Passed as the first argument of a memory manager's create_object, which hands it on to
+// the allocator policy's create, to allocate the object from the given memory resource.
+// Only pmr_allocator accepts it.
+struct from_resource {
+  std::pmr::memory_resource* resource;
+};
+
+// Create an object with the given allocator policy, passing stamp as the first argument
+// of its constructor, for the memory managers whose objects record when they were born.
+// A from_resource among the arguments is meant for the allocator, so it stays in front.
+template<typename Allocator, typename Stamp, typename... Args>
+auto create_stamped(Allocator& allocator, Stamp stamp, Args&&... args) {
+  return allocator.create(stamp, std::forward<Args>(args)...);
+}
+
+template<typename Allocator, typename Stamp, typename... Args>
+auto create_stamped(Allocator& allocator, Stamp stamp, from_resource from, Args&&... args) {
+  return allocator.create(from, stamp, std::forward<Args>(args)...);
+}
+
+}  // namespace internal
+
+// Allocator policy that stores objects of type U in a std::pmr::memory_resource.
+//
+// Objects are allocated from the resource passed to allocate_rc, which reaches create as
+// a leading internal::from_resource argument, or from the default resource when they are
+// created by make_shared. The resource is recorded in a header in front of each object,
+// so an object is always returned to the resource that it came from, regardless of which
+// thread ends up destroying it. A resource must outlive every object allocated from it,
+// including the ones whose destruction is still deferred.
+template<typename U>
+struct pmr_allocator {
+  constexpr static bool uses_memory_resource = true;
+
+  template<typename... Args>
+  U* create(Args&&... args) {
+    return create(internal::from_resource{std::pmr::get_default_resource()}, std::forward<Args>(args)...);
+  }
+
+  template<typename... Args>
+  U* create(internal::from_resource from, Args&&... args) {
+    auto resource = from.resource;
+    auto block = static_cast<unsigned char*>(resource->allocate(block_size, block_align));
+    new (block) std::pmr::memory_resource*(resource);
+    try {
+      return new (block + header_size) U(std::forward<Args>(args)...);
+    } catch (...) {
+      resource->deallocate(block, block_size, block_align);
+      throw;
+    }
+  }
+
+  void destroy(U* p) {
+    auto block = reinterpret_cast<unsigned char*>(p) - header_size;
+    auto resource = *std::launder(reinterpret_cast<std::pmr::memory_resource**>(block));
+    p->~U();
+    resource->deallocate(block, block_size, block_align);
+  }
+
+ private:
+  constexpr static size_t block_align = std::max(alignof(U), alignof(std::pmr::memory_resource*));
+  constexpr static size_t header_size = (sizeof(std::pmr::memory_resource*) + block_align - 1) / block_align * block_align;
+  constexpr static size_t block_size = header_size + sizeof(U);
+};
+
+}  // namespace cdrc
+
+#endif  // CDRC_INTERNAL_PMR_ALLOCATOR_H
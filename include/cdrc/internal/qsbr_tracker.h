@@ -0,0 +1,152 @@
+
+#ifndef CDRC_INTERNAL_QSBR_TRACKER_H
+#define CDRC_INTERNAL_QSBR_TRACKER_H
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+
+#include <atomic>
+#include <algorithm>
+#include <limits>
+
+#include "utils.h"
+
+namespace cdrc {
+namespace internal {
+
+// Tracks quiescent states for quiescent-state-based reclamation (QSBR).
+//
+// Each online thread announces the global epoch that it observed at its
+// most recent quiescent state, i.e., the last point at which it held no
+// references to shared objects. Offline threads announce no_epoch and are
+// ignored. An object retired at epoch e is therefore safe to reclaim once
+// every online thread has announced an epoch greater than e.
+//
+// A thread that is offline (which includes threads that have never used
+// QSBR before) is brought online automatically by its first protected
+// read. Threads are taken offline automatically when they exit.
+struct qsbr_tracker {
+
+  using epoch_type = uint64_t;
+  constexpr static epoch_type no_epoch = std::numeric_limits<epoch_type>::max();
+
+  struct alignas(128) Epoch : public std::atomic<epoch_type> {
+    Epoch() : std::atomic<epoch_type>(no_epoch) {}
+
+    explicit Epoch(epoch_type x) : std::atomic<epoch_type>(x) {}
+
+    Epoch(const Epoch &other) : std::atomic<epoch_type>(other.load()) {}
+
+    ~Epoch() = default;
+  };
+
+  static qsbr_tracker& instance() {
+    static qsbr_tracker tracker;
+    return tracker;
+  }
+
+  // Return the value of the current global epoch
+  epoch_type get_current_epoch() {
+    return global_epoch.load();
+  }
+
+  // Increment the global epoch
+  auto advance_global_epoch() {
+    return global_epoch.fetch_add(1);
+  }
+
+  // Return the value of the earliest announced epoch. Returns
+  // numeric_limits<epoch_type>::max() if no threads are online.
+  epoch_type get_min_announced_epoch() {
+    epoch_type answer = std::numeric_limits<epoch_type>::max();
+    auto nt = utils::num_thread_ids();
+    for (size_t i = 0; i < nt; i++) {
+      answer = std::min(answer, local_epoch[i].load(std::memory_order_acquire));
+    }
+    return answer;
+  }
+
+  // Announce that the calling thread holds no references to shared objects.
+  // Only writes to the announcement if the global epoch has moved since the
+  // previous quiescent state, so calling it frequently is cheap.
+  void quiescent_state() {
+    auto id = utils::threadID.getTID();
+    auto current = global_epoch.load(std::memory_order_acquire);
+    if (local_epoch[id].load(std::memory_order_relaxed) != current) {
+      announce(id, current);
+    }
+  }
+
+  // Bring the calling thread online. It may then perform protected reads
+  // until its next quiescent state or until it goes offline.
+  void online() {
+    auto id = utils::threadID.getTID();
+    announce(id, global_epoch.load(std::memory_order_acquire));
+  }
+
+  // Take the calling thread offline. It must not hold any references to
+  // shared objects that it obtained while it was online.
+  void offline() {
+    auto id = utils::threadID.getTID();
+    local_epoch[id].store(no_epoch, std::memory_order_release);
+  }
+
+  // Bring the calling thread online if it is currently offline
+  void ensure_online() {
+    auto id = utils::threadID.getTID();
+    if (local_epoch[id].load(std::memory_order_relaxed) == no_epoch) {
+      announce(id, global_epoch.load(std::memory_order_acquire));
+    }
+  }
+
+  bool is_online() {
+    auto id = utils::threadID.getTID();
+    return local_epoch[id].load(std::memory_order_relaxed) != no_epoch;
+  }
+
+private:
+  qsbr_tracker() : global_epoch(0) {}
+
+  // Take the thread offline when it exits so that it
+  // does not hold back reclamation forever
+  struct ExitHook {
+    bool armed{false};
+    ~ExitHook() { if (armed) qsbr_tracker::instance().offline(); }
+  };
+
+  void announce(size_t id, epoch_type e) {
+    static thread_local ExitHook exit_hook;
+    exit_hook.armed = true;
+    local_epoch[id].store(e, std::memory_order_seq_cst);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+  }
+
+  Epoch global_epoch;
+  utils::PerThreadArray<Epoch> local_epoch;
+};
+
+}  // namespace internal
+
+// Announce a quiescent state for the calling thread, i.e., a point at which it
+// holds no snapshot pointers or other unprotected references to shared objects
+// managed by the QSBR backend.
+inline void quiescent_state() {
+  internal::qsbr_tracker::instance().quiescent_state();
+}
+
+// Take the calling thread offline, e.g., before blocking for a long time. An
+// offline thread does not hold back reclamation. It is brought back online by
+// qsbr_online(), or implicitly by its next protected read.
+inline void qsbr_offline() {
+  internal::qsbr_tracker::instance().offline();
+}
+
+// Bring the calling thread back online
+inline void qsbr_online() {
+  internal::qsbr_tracker::instance().online();
+}
+
+}  // namespace cdrc
+
+#endif  // CDRC_INTERNAL_QSBR_TRACKER_H
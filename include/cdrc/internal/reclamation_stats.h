@@ -0,0 +1,206 @@
+
+#ifndef CDRC_INTERNAL_RECLAMATION_STATS_H
+#define CDRC_INTERNAL_RECLAMATION_STATS_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <type_traits>
+#include <utility>
+
+#include "utils.h"
+
+namespace cdrc {
+
+// A snapshot of the statistics of a memory manager, taken by cdrc::stats. Counters are
+// summed over the threads, while high-water marks and maximums are taken over them. Only
+// the creates, destroys, limit hits and breaches are counted without CDRC_STATS, and the
+// rest are then always zero. Nothing is counted per retire or per eject: a thread counts
+// its retires by how much its deferred actions grew since its previous pass, and its ejects
+// by how many deferred actions its passes removed. Hyaline, which makes no passes, counts
+// the batches that a thread adds and applies, and publishes them every few batches. So the
+// retires less the ejects are the deferred actions still pending, give or take the recent
+// retires and ejects of the other threads.
+struct reclamation_stats {
+  uint64_t creates = 0;                    // Objects created
+  uint64_t destroys = 0;                   // Objects destroyed
+  uint64_t retires = 0;                    // Deferred actions, of every retire type
+  uint64_t ejects = 0;                     // Deferred actions found safe to apply
+  uint64_t eject_passes = 0;               // Passes over the deferred actions of a thread, or steps of resumable ones
+  uint64_t scan_ns = 0;                    // Total time spent in those passes, estimated from the timed ones
+  uint64_t max_scan_ns = 0;                // Longest of the timed passes
+  uint64_t deferred_high_water = 0;        // Most deferred actions held by a thread at once
+  uint64_t snapshot_slot_overflows = 0;    // Snapshots that took a reference since no slot was free
+  uint64_t epoch_advances = 0;             // Epochs or eras advanced by the memory manager
+  uint64_t soft_limit_hits = 0;            // Retires that found the soft deferred limit exceeded
+  uint64_t hard_limit_hits = 0;            // Retires that found the hard deferred limit exceeded
+  uint64_t hard_limit_breaches = 0;        // Passes forced by the hard limit that left it exceeded twice in a row
+};
+
+namespace internal {
+
+// The memory managers only collect statistics on their reclamation work if CDRC_STATS is
+// defined, and otherwise the code that collects them compiles to nothing. It must be defined
+// the same way in every translation unit of a program.
+#ifdef CDRC_STATS
+constexpr static bool stats_enabled = true;
+#else
+constexpr static bool stats_enabled = false;
+#endif
+
+// The statistics of one thread for one memory manager. Each counter is only updated by its
+// own thread, so updates are a plain load and store rather than a read-modify-write, while
+// cdrc::stats can still read them from any thread.
+struct alignas(128) ThreadStats {
+  // Only every this many passes of a thread is timed, which keeps the clock off the hot path
+  constexpr static uint64_t timed_pass_interval = 64;
+
+  struct Counter {
+    std::atomic<uint64_t> value{0};
+
+    void add(uint64_t n) { value.store(value.load(std::memory_order_relaxed) + n, std::memory_order_relaxed); }
+
+    void raise_to(uint64_t n) {
+      if (n > value.load(std::memory_order_relaxed)) value.store(n, std::memory_order_relaxed);
+    }
+
+    uint64_t get() const { return value.load(std::memory_order_relaxed); }
+  };
+
+  // Count the retires of this thread as the growth of its deferred actions, of which it now
+  // holds the given number, since they were last counted
+  void count_retires(uint64_t deferred) {
+    retires.add(deferred - counted_deferred);
+    counted_deferred = deferred;
+  }
+
+  // Count the retires of this thread as it gives up the given number of deferred actions
+  void count_released(uint64_t deferred) {
+    count_retires(deferred);
+    counted_deferred = 0;
+  }
+
+  // Add the statistics of this thread to the given snapshot
+  void collect(reclamation_stats& s) const {
+    s.retires += retires.get();
+    s.ejects += ejects.get();
+    s.eject_passes += eject_passes.get();
+    auto timed = timed_passes.get();
+    if (timed > 0) s.scan_ns += timed_scan_ns.get() * eject_passes.get() / timed;
+    s.max_scan_ns = std::max(s.max_scan_ns, max_scan_ns.get());
+    s.deferred_high_water = std::max(s.deferred_high_water, deferred_high_water.get());
+    s.snapshot_slot_overflows += snapshot_slot_overflows.get();
+    s.epoch_advances += epoch_advances.get();
+  }
+
+  Counter retires;
+  Counter ejects;
+  Counter eject_passes;
+  Counter timed_passes;
+  Counter timed_scan_ns;
+  Counter max_scan_ns;
+  Counter deferred_high_water;
+  Counter snapshot_slot_overflows;
+  Counter epoch_advances;
+  uint64_t counted_deferred = 0;           // The deferred actions of the thread that its retires count, for its own use
+};
+
+// The statistics of the current thread for a memory manager that adds its deferred actions
+// in batches, which are yet to be added to its ThreadStats. Batches can be added and applied
+// about as often as objects are retired, too often to look the statistics of the thread up
+// each time, so they are counted in a thread-local BatchStats, and published every
+// publish_interval batches.
+struct BatchStats {
+  constexpr static uint64_t publish_interval = 64;
+
+  // Count the retires of the thread as the growth of the deferred actions in its partial
+  // batch, of which there are now the given number, since they were last counted
+  void count_retires(uint64_t deferred) {
+    retires += deferred - counted;
+    counted = deferred;
+  }
+
+  // Count the retires of the thread as it gives up its partial batch, with the given number
+  // of deferred actions, by adding it or handing it off. Returns whether to publish.
+  bool release(uint64_t deferred) {
+    count_retires(deferred);
+    counted = 0;
+    high_water = std::max(high_water, deferred);
+    return ++batches % publish_interval == 0;
+  }
+
+  // Count the given number of deferred actions of a batch that the thread applied. Returns
+  // whether to publish.
+  bool apply(uint64_t applied) {
+    ejects += applied;
+    return ++batches % publish_interval == 0;
+  }
+
+  // Add the counts to the given statistics of the thread
+  void publish(ThreadStats& stats) {
+    stats.retires.add(std::exchange(retires, 0));
+    stats.ejects.add(std::exchange(ejects, 0));
+    stats.deferred_high_water.raise_to(std::exchange(high_water, 0));
+  }
+
+  uint64_t retires = 0;
+  uint64_t ejects = 0;
+  uint64_t high_water = 0;
+  uint64_t counted = 0;                    // The deferred actions in the partial batch that retires counts
+  uint64_t batches = 0;                    // Batches added or applied
+};
+
+// Stands in for the statistics of the threads without CDRC_STATS. It is only named by
+// discarded statements, so it takes no space and its operator is never defined.
+struct NoThreadStats {
+  ThreadStats& operator[](size_t) const;
+};
+
+using PerThreadStats = std::conditional_t<stats_enabled, utils::PerThreadArray<ThreadStats>, NoThreadStats>;
+
+// The statistics of a pass over deferred actions while it runs, which are empty unless
+// statistics are enabled. It holds the statistics of its thread, so that a pass only looks
+// them up once. Reading the clock costs more than the rest of the statistics together, so
+// only every ThreadStats::timed_pass_interval-th pass of a thread is timed.
+struct PassStats {
+#ifdef CDRC_STATS
+  ThreadStats* stats = nullptr;
+  std::chrono::steady_clock::time_point start;
+
+  PassStats() = default;
+
+  explicit PassStats(ThreadStats& stats_) : stats(&stats_) {
+    if (stats->eject_passes.get() % ThreadStats::timed_pass_interval == 0) start = std::chrono::steady_clock::now();
+  }
+
+  // Add the pass, which removed the given number of deferred actions, to the statistics
+  // of its thread once it is done
+  void finish(size_t removed) const {
+    stats->ejects.add(removed);
+    stats->counted_deferred -= removed;
+    stats->eject_passes.add(1);
+    if (start != std::chrono::steady_clock::time_point{}) {
+      auto ns = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start).count());
+      stats->timed_passes.add(1);
+      stats->timed_scan_ns.add(ns);
+      stats->max_scan_ns.raise_to(ns);
+    }
+  }
+#else
+  PassStats() = default;
+
+  explicit PassStats(ThreadStats&) {}
+
+  void finish(size_t) const {}
+#endif
+};
+
+}  // namespace internal
+
+}  // namespace cdrc
+
+#endif  // CDRC_INTERNAL_RECLAMATION_STATS_H
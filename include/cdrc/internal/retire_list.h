@@ -0,0 +1,415 @@
+#ifndef CDRC_INTERNAL_RETIRE_LIST_H
+#define CDRC_INTERNAL_RETIRE_LIST_H
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+
+#include <algorithm>
+#include <atomic>
+#include <iterator>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace cdrc {
+
+namespace internal {
+
+// A thread-local list of deferred actions, stored as a linked list of fixed-size
+// chunks. Appending never moves the existing entries, so the cost of a retire does
+// not depend on the size of the backlog, and a sweep relinks the entries that it
+// keeps instead of copying them into a new list. Chunks that become empty are kept
+// in a small pool of spare chunks and reused by later appends.
+//
+// Entries can be appended with a stamp, such as the epoch that they were retired in.
+// A chunk only ever holds entries with the same stamp, so stamps are stored once per
+// chunk rather than once per entry. Only a sweep that compacts the list can raise the
+// stamp of an entry, to the stamp of one that follows it.
+//
+// A sweep can also be made a few entries at a time with sweep_some, which resumes from
+// where the previous call stopped, so that no single call costs time proportional to
+// the size of the list.
+//
+// Entries are appended only by the owning thread, so no synchronization is needed. A
+// thread can instead hand its entries off to a shared handoff, from which another
+// thread adopts them into its own list.
+template<typename Entry>
+class alignas(128) retire_list {
+
+  static_assert(std::is_trivially_copyable_v<Entry> && std::is_trivially_destructible_v<Entry>);
+
+  constexpr static size_t chunk_bytes = 1024;
+
+  struct Chunk {
+    Chunk* next = nullptr;
+    size_t size = 0;
+    uint64_t stamp = 0;
+
+    // Only used by the first chunk of a list that was handed off
+    Chunk* next_list = nullptr;
+    Chunk* list_tail = nullptr;
+    size_t list_size = 0;
+
+    Entry& operator[](size_t i) { return *std::launder(reinterpret_cast<Entry*>(storage) + i); }
+
+    // Leaves room for the fields above within chunk_bytes
+    constexpr static size_t capacity = std::max<size_t>(8, (chunk_bytes - 64) / sizeof(Entry));
+    alignas(Entry) unsigned char storage[capacity * sizeof(Entry)];
+  };
+
+  // The maximum number of empty chunks that are kept for reuse
+  constexpr static size_t max_spare_chunks = 16;
+
+ public:
+
+  class iterator {
+   public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = Entry;
+    using difference_type = std::ptrdiff_t;
+    using pointer = Entry*;
+    using reference = Entry&;
+
+    iterator() : chunk(nullptr), i(0) {}
+
+    reference operator*() const { return (*chunk)[i]; }
+    pointer operator->() const { return &(*chunk)[i]; }
+
+    iterator& operator++() {
+      if (++i == chunk->size) {
+        chunk = chunk->next;
+        i = 0;
+      }
+      return *this;
+    }
+
+    iterator operator++(int) {
+      auto result = *this;
+      ++*this;
+      return result;
+    }
+
+    friend bool operator==(const iterator& a, const iterator& b) { return a.chunk == b.chunk && a.i == b.i; }
+
+   private:
+    friend class retire_list;
+
+    // Chunks in a list are never empty, so every entry has a unique iterator
+    // and the end of a list is always (nullptr, 0)
+    iterator(Chunk* chunk_, size_t i_) : chunk(chunk_), i(i_) {}
+
+    Chunk* chunk;
+    size_t i;
+  };
+
+  // A lock-free stack of lists that were handed off by the threads that own them, from
+  // which other threads adopt them. Lists are only ever removed from the stack all at once
+  // by an exchange, and never popped, so the stack is not susceptible to ABA.
+  class handoff {
+   public:
+    handoff() = default;
+
+    handoff(const handoff&) = delete;
+    handoff& operator=(const handoff&) = delete;
+
+    ~handoff() {
+      Chunk* list = top.load();
+      while (list != nullptr) {
+        Chunk* next = list->next_list;
+        free_chunks(list);
+        list = next;
+      }
+    }
+
+    bool empty() const { return top.load(std::memory_order_relaxed) == nullptr; }
+
+   private:
+    friend class retire_list;
+    std::atomic<Chunk*> top{nullptr};
+  };
+
+  retire_list() = default;
+
+  retire_list(const retire_list&) = delete;
+  retire_list& operator=(const retire_list&) = delete;
+
+  ~retire_list() {
+    free_chunks(head);
+    free_chunks(swept);
+    free_chunks(spare);
+  }
+
+  void push_back(const Entry& x, uint64_t stamp = 0) {
+    if (tail == nullptr || tail->size == Chunk::capacity || tail->stamp != stamp) {
+      auto chunk = new_chunk();
+      chunk->stamp = stamp;
+      if (tail == nullptr) head = chunk;
+      else tail->next = chunk;
+      tail = chunk;
+    }
+    new (&(*tail)[tail->size]) Entry(x);
+    tail->size++;
+    count++;
+  }
+
+  // Stops any sweep that sweep_some has in progress first
+  iterator begin() {
+    stop_sweep();
+    return {head, 0};
+  }
+
+  iterator end() { return {}; }
+
+  // Includes the entries that a sweep in progress has kept or not examined yet
+  size_t size() const { return count; }
+  bool empty() const { return count == 0; }
+
+  void clear() {
+    stop_sweep();
+    recycle_chunks(head);
+    head = tail = nullptr;
+    count = 0;
+  }
+
+  // Move every entry of this list to the given handoff
+  void hand_off(handoff& to) {
+    stop_sweep();
+    if (head == nullptr) return;
+    Chunk* list = head;
+    list->list_tail = tail;
+    list->list_size = count;
+    head = tail = nullptr;
+    count = 0;
+    list->next_list = to.top.load(std::memory_order_relaxed);
+    while (!to.top.compare_exchange_weak(list->next_list, list, std::memory_order_release, std::memory_order_relaxed)) {}
+  }
+
+  // Append every list that was handed off to the given handoff to this list. Returns
+  // the number of entries that were appended.
+  size_t adopt(handoff& from) {
+    if (from.empty()) return 0;
+    Chunk* list = from.top.exchange(nullptr, std::memory_order_acquire);
+    size_t adopted = 0;
+    while (list != nullptr) {
+      Chunk* next = list->next_list;
+      if (tail == nullptr) head = list;
+      else tail->next = list;
+      tail = list->list_tail;
+      adopted += list->list_size;
+      list = next;
+    }
+    count += adopted;
+    return adopted;
+  }
+
+  // Remove the entries for which keep returns false, and pass them as a range of
+  // iterators to eject. The entries that are kept are relinked in front of any
+  // entries that eject appends to the list while it runs. Returns the number of
+  // entries that were removed.
+  template<typename Keep, typename Eject>
+  size_t sweep(Keep keep, Eject eject) {
+    Chunk* chain = std::exchange(head, nullptr);
+    size_t total = std::exchange(count, 0);
+    tail = nullptr;
+
+    auto ready = std::partition(iterator{chain, 0}, iterator{}, keep);
+    eject(ready, iterator{});
+    auto kept = relink_kept(chain, ready);
+    count += kept;
+    return total - kept;
+  }
+
+  // Like sweep, but keep is also passed the stamp of the chunk that holds each entry. The
+  // entries that are kept are moved towards the front of the list in order, and a chunk
+  // takes the largest stamp of the entries that are moved into it, so the stamp of a kept
+  // entry can only increase.
+  template<typename Keep, typename Eject>
+  size_t sweep_with_stamps(Keep keep, Eject eject) {
+    Chunk* chain = std::exchange(head, nullptr);
+    size_t total = std::exchange(count, 0);
+    tail = nullptr;
+
+    iterator ready{chain, 0};
+    for (Chunk* c = chain; c != nullptr; c = c->next) {
+      // Entries are only ever moved backwards, so no entry of a later chunk has been
+      // moved into this one yet
+      uint64_t stamp = c->stamp;
+      for (size_t i = 0; i < c->size; i++) {
+        if (keep((*c)[i], stamp)) move_kept(ready, (*c)[i], stamp);
+      }
+    }
+    eject(ready, iterator{});
+    auto kept = relink_kept(chain, ready);
+    count += kept;
+    return total - kept;
+  }
+
+  // Whether a sweep that sweep_some started is yet to examine some of its entries
+  bool sweeping() const { return swept != nullptr; }
+
+  // Like sweep_with_stamps, but examines at most limit entries, and resumes from where the
+  // previous call stopped, so a call costs time proportional to limit however long the list
+  // is. The call that starts a sweep detaches every entry of the list, so a sweep only
+  // examines entries that were appended before it started, and the entries that are appended
+  // in the meantime form a new list. Each entry that is removed is passed to eject on its own,
+  // and once the sweep has examined every entry, the ones that it kept are relinked in front
+  // of the new list. Returns the number of entries that were removed.
+  template<typename Keep, typename Eject>
+  size_t sweep_some(size_t limit, Keep keep, Eject eject) {
+    if (swept == nullptr) {
+      if (head == nullptr) return 0;
+      swept = std::exchange(head, nullptr);
+      tail = nullptr;
+      next_examined = next_kept = iterator{swept, 0};
+    }
+
+    size_t removed = 0;
+    for (size_t n = 0; n < limit && next_examined != iterator{}; n++, ++next_examined) {
+      auto stamp = next_examined.chunk->stamp;
+      if (keep(*next_examined, stamp)) {
+        move_kept(next_kept, *next_examined, stamp);
+      }
+      else {
+        eject(*next_examined);
+        removed++;
+      }
+    }
+    count -= removed;
+    if (next_examined == iterator{}) relink_kept(std::exchange(swept, nullptr), next_kept);
+    return removed;
+  }
+
+  // Stop the sweep that sweep_some has in progress, if any, keeping every entry that it has
+  // not examined yet
+  void stop_sweep() {
+    if (swept == nullptr) return;
+    sweep_some(count, [](const Entry&, uint64_t) { return true; }, [](const Entry&) {});
+    assert(swept == nullptr);
+  }
+
+  // Remove every chunk whose stamp is less than the given stamp, and pass their entries
+  // as a range of iterators to eject. Only the stamps of the chunks are compared, so this
+  // costs little even when few entries are ejected. Returns the number of entries that
+  // were removed.
+  template<typename Eject>
+  size_t sweep_stamped_before(uint64_t stamp, Eject eject) {
+    Chunk* chain = nullptr;
+    Chunk** chain_end = &chain;
+    Chunk* last = nullptr;
+    size_t n = 0;
+    for (Chunk** link = &head; *link != nullptr;) {
+      Chunk* c = *link;
+      if (c->stamp < stamp) {
+        *link = c->next;
+        c->next = nullptr;
+        *chain_end = c;
+        chain_end = &c->next;
+        n += c->size;
+      }
+      else {
+        last = c;
+        link = &c->next;
+      }
+    }
+    if (chain == nullptr) return 0;
+    tail = last;
+    count -= n;
+
+    eject(iterator{chain, 0}, iterator{});
+    recycle_chunks(chain);
+    return n;
+  }
+
+ private:
+  // Move an entry that a sweep keeps, from a chunk with the given stamp, to the position
+  // ready, and advance ready. The entries are moved towards the front of the list in order,
+  // and a chunk takes the largest stamp of the entries that are moved into it.
+  static void move_kept(iterator& ready, Entry& x, uint64_t stamp) {
+    if (ready.i == 0 || ready.chunk->stamp < stamp) ready.chunk->stamp = stamp;
+    std::swap(*ready, x);
+    ++ready;
+  }
+
+  // Cut the given chain before ready, recycle the chunks after it, and link the chunks
+  // before it in front of the list. Returns the number of entries that were kept, which
+  // the caller adds to the count of the list if it is not included yet.
+  size_t relink_kept(Chunk* chain, iterator ready) {
+    if (ready == iterator{chain, 0}) {
+      recycle_chunks(chain);
+      return 0;
+    }
+
+    // Cut the chain after the last entry that is kept, and recycle the rest
+    Chunk* last = chain;
+    size_t kept = 0;
+    while (true) {
+      if (last == ready.chunk) {
+        last->size = ready.i;
+        kept += ready.i;
+        break;
+      }
+      kept += last->size;
+      if (ready.i == 0 && last->next == ready.chunk) break;
+      last = last->next;
+    }
+    recycle_chunks(last->next);
+
+    last->next = head;
+    head = chain;
+    if (tail == nullptr) tail = last;
+    return kept;
+  }
+
+  Chunk* new_chunk() {
+    if (spare == nullptr) return new Chunk;
+    Chunk* chunk = spare;
+    spare = chunk->next;
+    num_spare--;
+    chunk->next = nullptr;
+    chunk->size = 0;
+    return chunk;
+  }
+
+  void recycle_chunks(Chunk* chunk) {
+    while (chunk != nullptr) {
+      Chunk* next = chunk->next;
+      if (num_spare < max_spare_chunks) {
+        chunk->next = spare;
+        spare = chunk;
+        num_spare++;
+      }
+      else {
+        delete chunk;
+      }
+      chunk = next;
+    }
+  }
+
+  static void free_chunks(Chunk* chunk) {
+    while (chunk != nullptr) {
+      Chunk* next = chunk->next;
+      delete chunk;
+      chunk = next;
+    }
+  }
+
+  Chunk* head = nullptr;
+  Chunk* tail = nullptr;
+  size_t count = 0;
+
+  // The entries detached by the sweep of sweep_some that is in progress, if any, of which
+  // those before next_kept are kept, and those from next_examined on are yet to be examined
+  Chunk* swept = nullptr;
+  iterator next_examined;
+  iterator next_kept;
+
+  Chunk* spare = nullptr;
+  size_t num_spare = 0;
+};
+
+}  // namespace internal
+
+}  // namespace cdrc
+
+#endif  // CDRC_INTERNAL_RETIRE_LIST_H
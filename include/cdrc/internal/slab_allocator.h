@@ -0,0 +1,221 @@
+#ifndef CDRC_INTERNAL_SLAB_ALLOCATOR_H
+#define CDRC_INTERNAL_SLAB_ALLOCATOR_H
+
+#include <cassert>
+#include <cstddef>
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <new>
+#include <utility>
+
+#include "utils.h"
+
+namespace cdrc {
+
+namespace internal {
+
+// The size of the slots used to store objects of the given size and alignment.
+// Sizes up to 128 bytes are rounded up to a multiple of 16, and larger sizes to
+// a multiple of a quarter of their power of two, so objects of similar sizes
+// share a size class and the space wasted by rounding is at most 25%.
+constexpr size_t slab_size_class(size_t size, size_t align) {
+  size_t s = std::max({size, align, 2 * sizeof(void*)});
+  size_t step = (s <= 128) ? 16 : std::bit_floor(s) / 4;
+  step = std::max(step, align);
+  return (s + step - 1) / step * step;
+}
+
+// A pool of fixed-size slots that are carved out of large slabs, shared by all
+// objects whose size class is slot_size.
+//
+// Each thread allocates from and frees to its own magazine, a free-list of slots,
+// without any synchronization. When a magazine grows too large, which happens to
+// threads that mostly free objects allocated by other threads, a chunk of its slots
+// is moved to a shared depot. A thread whose magazine is empty refills it with a
+// chunk from the depot, and only allocates a new slab if the depot is empty.
+// Slabs are only released when the pool is destroyed.
+template<size_t slot_size, size_t slot_align>
+class slab_pool {
+
+  static_assert(slot_size >= 2 * sizeof(void*) && slot_size % slot_align == 0);
+
+  // A free slot. Slots in the depot are grouped into chunks of
+  // chunk_size slots, and the chunks are linked through next_chunk
+  struct FreeSlot {
+    FreeSlot* next;
+    FreeSlot* next_chunk;
+  };
+
+  struct Slab {
+    Slab* next;
+  };
+
+  struct alignas(128) Magazine {
+    FreeSlot* free = nullptr;
+    size_t size = 0;
+  };
+
+  // Number of slots moved between a magazine and the depot at once
+  constexpr static size_t chunk_size = 256;
+
+  // Maximum number of free slots that a thread keeps in its magazine
+  constexpr static size_t max_magazine_size = 2 * chunk_size;
+
+  // Slabs are at least 64KiB and hold at least 64 slots
+  constexpr static size_t slab_header_size = (sizeof(Slab) + slot_align - 1) / slot_align * slot_align;
+  constexpr static size_t slots_per_slab = std::max<size_t>(64, (64 * 1024 - slab_header_size) / slot_size);
+  constexpr static size_t slab_bytes = slab_header_size + slots_per_slab * slot_size;
+  constexpr static std::align_val_t slab_align{std::max(slot_align, alignof(std::max_align_t))};
+
+ public:
+  static slab_pool& instance() {
+    static slab_pool pool;
+    return pool;
+  }
+
+  void* allocate() {
+    auto& magazine = magazines[utils::threadID.getTID()];
+    if (magazine.free == nullptr) refill(magazine);
+    FreeSlot* slot = magazine.free;
+    magazine.free = slot->next;
+    magazine.size--;
+    return slot;
+  }
+
+  void deallocate(void* p) {
+    auto& magazine = magazines[utils::threadID.getTID()];
+    auto slot = static_cast<FreeSlot*>(p);
+    slot->next = magazine.free;
+    magazine.free = slot;
+    magazine.size++;
+    if (magazine.size >= max_magazine_size) spill(magazine);
+  }
+
+  // The total number of slots that have been carved out of slabs
+  size_t capacity() const {
+    return num_slabs.load(std::memory_order_relaxed) * slots_per_slab;
+  }
+
+  slab_pool() : depot(nullptr), slabs(nullptr), num_slabs(0) {}
+
+  slab_pool(const slab_pool&) = delete;
+  slab_pool& operator=(const slab_pool&) = delete;
+
+  ~slab_pool() {
+    Slab* slab = slabs.load();
+    while (slab != nullptr) {
+      Slab* next = slab->next;
+      ::operator delete(static_cast<void*>(slab), slab_bytes, slab_align);
+      slab = next;
+    }
+  }
+
+ private:
+  // Move chunk_size slots from the given magazine to the depot
+  void spill(Magazine& magazine) {
+    FreeSlot* chunk = magazine.free;
+    FreeSlot* last = chunk;
+    for (size_t i = 1; i < chunk_size; i++) last = last->next;
+    magazine.free = last->next;
+    magazine.size -= chunk_size;
+    last->next = nullptr;
+    push_chunks(chunk, chunk);
+  }
+
+  // Push a list of chunks, linked through next_chunk, to the depot
+  void push_chunks(FreeSlot* first, FreeSlot* last) {
+    FreeSlot* head = depot.load(std::memory_order_relaxed);
+    do {
+      last->next_chunk = head;
+    } while (!depot.compare_exchange_weak(head, first, std::memory_order_release, std::memory_order_relaxed));
+  }
+
+  // Refill an empty magazine with a chunk from the depot, or with a new slab
+  // if there are none. The depot is only ever emptied by exchange, and never
+  // popped from, so it is not susceptible to ABA.
+  void refill(Magazine& magazine) {
+    assert(magazine.free == nullptr);
+    FreeSlot* chunks = depot.exchange(nullptr, std::memory_order_acquire);
+    if (chunks != nullptr) {
+      FreeSlot* rest = chunks->next_chunk;
+      if (rest != nullptr) {
+        FreeSlot* last = rest;
+        while (last->next_chunk != nullptr) last = last->next_chunk;
+        push_chunks(rest, last);
+      }
+      magazine.free = chunks;
+      magazine.size = chunk_size;
+    }
+    else {
+      auto slab = static_cast<Slab*>(::operator new(slab_bytes, slab_align));
+      auto base = reinterpret_cast<unsigned char*>(slab) + slab_header_size;
+      auto slot = [base](size_t i) { return reinterpret_cast<FreeSlot*>(base + i * slot_size); };
+      for (size_t i = 0; i + 1 < slots_per_slab; i++) slot(i)->next = slot(i + 1);
+      slot(slots_per_slab - 1)->next = nullptr;
+      magazine.free = slot(0);
+      magazine.size = slots_per_slab;
+      slab->next = slabs.load(std::memory_order_relaxed);
+      while (!slabs.compare_exchange_weak(slab->next, slab)) {}
+      num_slabs.fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+
+  utils::PerThreadArray<Magazine> magazines;
+  alignas(128) std::atomic<FreeSlot*> depot;
+  alignas(128) std::atomic<Slab*> slabs;
+  std::atomic<size_t> num_slabs;
+};
+
+}  // namespace internal
+
+// Allocator policy that creates and destroys objects of type U with new and delete
+template<typename U>
+struct new_delete_allocator {
+  template<typename... Args>
+  U* create(Args&&... args) {
+    return new U(std::forward<Args>(args)...);
+  }
+
+  void destroy(U* p) {
+    delete p;
+  }
+};
+
+// Allocator policy that stores objects of type U in the slab pool of their size class.
+//
+// A backend holds an instance of its allocator policy, which makes sure that the pool
+// is created before the backend and therefore outlives any object that it manages.
+template<typename U>
+struct slab_allocator {
+  using pool_type = internal::slab_pool<internal::slab_size_class(sizeof(U), alignof(U)), alignof(U)>;
+
+  slab_allocator() : pool(pool_type::instance()) {}
+
+  template<typename... Args>
+  U* create(Args&&... args) {
+    auto slot = pool.allocate();
+    try {
+      return new (slot) U(std::forward<Args>(args)...);
+    } catch (...) {
+      pool.deallocate(slot);
+      throw;
+    }
+  }
+
+  void destroy(U* p) {
+    p->~U();
+    pool.deallocate(p);
+  }
+
+  // The number of slots that the pool has reserved for objects of this size class
+  size_t capacity() const { return pool.capacity(); }
+
+ private:
+  pool_type& pool;
+};
+
+}  // namespace cdrc
+
+#endif  // CDRC_INTERNAL_SLAB_ALLOCATOR_H
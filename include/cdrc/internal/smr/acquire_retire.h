@@ -9,13 +9,15 @@
 #include <array>
 #include <atomic>
 #include <memory>
+#include <functional>
 #include <type_traits>
-#include <unordered_map>
 #include <utility>
 #include <vector>
 
 #include "../counted_object.h"
 #include "../memory_manager_base.h"
+#include "../retire_list.h"
+#include "../slab_allocator.h"
 #include "../utils.h"
 
 namespace cdrc {
@@ -37,22 +39,53 @@ namespace internal {
 //                  at a time, but makes reclamation slower
 // eject_delay =    The maximum number of deferred ejects that will be held by
 //                  any one worker thread is at most eject_delay * #threads.
+// asymmetric_fences = If true, announcements are published with only a compiler
+//                  barrier, and reclaimers instead issue a process-wide heavy
+//                  barrier (membarrier) before scanning the announcements. This
+//                  makes reads cheaper at the expense of ejects. Falls back to
+//                  ordinary seq_cst announcements if membarrier is unavailable.
+// Allocator =      The policy used to allocate the managed objects, either
+//                  new_delete_allocator or slab_allocator.
 //
-template<typename T, size_t snapshot_slots = 7, size_t eject_delay = 2>
-struct acquire_retire : public memory_manager_base<T, acquire_retire<T, snapshot_slots, eject_delay>> {
+template<typename T, size_t snapshot_slots = 7, size_t eject_delay = 2, bool asymmetric_fences = false, template<typename> typename Allocator = new_delete_allocator>
+struct acquire_retire : public memory_manager_base<T, acquire_retire<T, snapshot_slots, eject_delay, asymmetric_fences, Allocator>> {
 
-  using base = memory_manager_base<T, acquire_retire<T, snapshot_slots, eject_delay>>;
+  using base = memory_manager_base<T, acquire_retire<T, snapshot_slots, eject_delay, asymmetric_fences, Allocator>>;
 
   using base::increment_allocations;
   using base::decrement_allocations;
   using base::increment_ref_cnt;
   using base::decrement_weak_cnt;
   using base::eject;
+  using base::eject_ready;
+  using base::queue_eject;
+  using base::resume_sweep;
+  using base::bounded_ejects;
+  using base::unlimited_sweep;
+  using base::apply_queued_ejects;
+  using base::any_queued_ejects;
+  using base::release_immortals;
+  using base::take_queued_ejects;
+  using base::flush_queued_ejects;
+  using base::arm_thread_exit_hook;
+  using base::work_toward_ejects;
+  using base::hand_off_deferred;
+  using base::skip_retires;
+  using base::begin_pass;
+  using base::end_pass;
+  using base::record_snapshot_overflow;
+  using base::record_epoch_advance;
 
  private:
 
   using counted_object_t = counted_object<T>;
   using counted_ptr_t = std::add_pointer_t<counted_object_t>;
+  using retired_ptr = typename base::retired_ptr;
+
+  // The base class schedules the passes over deferred_destructs with eject_work, and
+  // makes them with eject_deferred
+  friend base;
+  constexpr static size_t eject_delay_per_thread = eject_delay;
 
   // Align to cache line boundary to avoid false sharing
   struct alignas(128) LocalSlot {
@@ -67,21 +100,31 @@ struct acquire_retire : public memory_manager_base<T, acquire_retire<T, snapshot
     }
   };
 
+  // An announced handle, along with the number of deferred actions of
+  // each retire type that its announcements are still able to protect
+  struct AnnouncedEntry {
+    counted_ptr_t ptr;
+    std::array<unsigned int, num_retire_types> remaining;
+  };
+
  public:
 
   static acquire_retire& instance() {
-    static acquire_retire ar{utils::num_threads()};
+    static acquire_retire ar;
     return ar;
   }
 
+  // The allocator policy used for the managed objects
+  using allocator_type = Allocator<counted_object_t>;
+
   template<typename... Args>
   counted_ptr_t create_object(Args &&... args) {
     increment_allocations();
-    return new counted_object_t(std::forward<Args>(args)...);
+    return allocator.create(std::forward<Args>(args)...);
   }
 
   void delete_object(counted_ptr_t p) {
-    delete p;
+    allocator.destroy(p);
     decrement_allocations();
   }
 
@@ -144,12 +187,7 @@ struct acquire_retire : public memory_manager_base<T, acquire_retire<T, snapshot
     std::atomic<counted_ptr_t> *slot;
   };
 
-  explicit acquire_retire(size_t num_threads) :
-      base(num_threads),
-      announcement_slots(num_threads),
-      in_progress(num_threads),
-      deferred_destructs(num_threads),
-      amortized_work(num_threads) {}
+  acquire_retire() = default;
 
   template<typename U>
   [[nodiscard]] acquired_pointer<U> acquire(const std::atomic<U> *p) {
@@ -157,7 +195,7 @@ struct acquire_retire : public memory_manager_base<T, acquire_retire<T, snapshot
     U result;
     do {
       result = p->load(std::memory_order_seq_cst);
-      announcement_slots[id].announcement.store(static_cast<counted_ptr_t>(result), std::memory_order_seq_cst);
+      announce(announcement_slots[id].announcement, static_cast<counted_ptr_t>(result));
     } while (p->load(std::memory_order_seq_cst) != result);
     return acquired_pointer<U>(result, &announcement_slots[id].announcement);
   }
@@ -167,8 +205,7 @@ struct acquire_retire : public memory_manager_base<T, acquire_retire<T, snapshot
   template<typename U>
   [[nodiscard]] acquired_pointer<U> reserve(U p) {
     auto id = utils::threadID.getTID();
-    announcement_slots[id].announcement.store(static_cast<counted_ptr_t>(p),
-                                              std::memory_order_seq_cst); // TODO: memory_order_release could be sufficient here
+    announce(announcement_slots[id].announcement, static_cast<counted_ptr_t>(p)); // TODO: memory_order_release could be sufficient here
     return acquired_pointer<U>(p, &announcement_slots[id].announcement);
   }
 
@@ -185,6 +222,7 @@ struct acquire_retire : public memory_manager_base<T, acquire_retire<T, snapshot
 
     // If no snapshot slot is available, just increment the reference count
     if (slot == nullptr) {
+      record_snapshot_overflow();
       while (true) {
         auto a = acquire(p);
         if (a.get() && increment_ref_cnt(a.get())) return acquired_pointer<U>(a.get(), nullptr);
@@ -200,7 +238,7 @@ struct acquire_retire : public memory_manager_base<T, acquire_retire<T, snapshot
         slot->store(nullptr, std::memory_order_release);
         return acquired_pointer<U>(result, nullptr);
       }
-      slot->store(static_cast<counted_ptr_t>(result), std::memory_order_seq_cst);
+      announce(*slot, static_cast<counted_ptr_t>(result));
     } while (p->load(std::memory_order_seq_cst) != result);
     return acquired_pointer<U>(result, slot);
   }
@@ -224,21 +262,35 @@ struct acquire_retire : public memory_manager_base<T, acquire_retire<T, snapshot
 
   void retire(counted_ptr_t p, RetireType type) {
     auto id = utils::threadID.getTID();
-    deferred_destructs[id].emplace_back(p, type);
-    work_toward_deferred_decrements(1);
+    arm_thread_exit_hook();
+    deferred_destructs[id].push_back(retired_ptr(p, type));
+    work_toward_ejects(id);
+  }
+
+  // Called by the exit hook of a thread that has retired objects. Applies the ejects that
+  // it has queued, and hands the rest of its deferred actions off to the remaining threads,
+  // which adopt them in their next pass.
+  void thread_exit() {
+    auto id = utils::threadID.getTID();
+    flush_queued_ejects();
+    hand_off_deferred(id);
   }
 
   // Perform any remaining deferred destruction. Need to be very careful
   // about additional objects being queued for deferred destruction by
   // an object that was just destructed.
   ~acquire_retire() {
-    in_progress.assign(in_progress.size(), true);
+    auto nt = utils::num_thread_ids();
+    for (size_t i = 0; i < nt; i++) in_progress[i] = true;
 
     // Loop because the destruction of one object could trigger the deferred
     // destruction of another object (possibly even in another thread), and
-    // so on recursively.
-    while (std::any_of(deferred_destructs.begin(), deferred_destructs.end(),
-                       [](const auto &v) { return !v.empty(); })) {
+    // so on recursively. The immortal objects are only released once nothing
+    // deferred can still refer to them.
+    while (any_deferred_destructs() || release_immortals()) {
+
+      // The actions handed off by exempt and exited threads are collected along with the rest
+      deferred_destructs[utils::threadID.getTID()].adopt(handed_off);
 
       // Move all of the contents from the deferred destruction lists
       // into a single local list. We don't want to just iterate the
@@ -246,10 +298,14 @@ struct acquire_retire : public memory_manager_base<T, acquire_retire<T, snapshot
       // deferred destruction to be added to one of the lists, which
       // would invalidate its iterators
       std::vector<std::pair<counted_ptr_t,RetireType>> destructs;
-      for (auto &v : deferred_destructs) {
-        destructs.insert(destructs.end(), v.begin(), v.end());
+      for (size_t i = 0; i < nt; i++) {
+        auto &v = deferred_destructs[i];
+        for (const auto& x : v) {
+          destructs.push_back(x.unpack());
+        }
         v.clear();
       }
+      take_queued_ejects(destructs);
 
       // Perform all of the pending deferred destructions
       for (const auto& x : destructs) {
@@ -259,11 +315,26 @@ struct acquire_retire : public memory_manager_base<T, acquire_retire<T, snapshot
   }
 
  private:
+  // Publish p in the given announcement slot such that it is ordered before
+  // any subsequent load, as seen by a concurrent scan_slots
+  void announce(std::atomic<counted_ptr_t>& slot, counted_ptr_t p) {
+    if (asymmetric_fences && light_announcements) {
+      slot.store(p, std::memory_order_relaxed);
+      utils::light_fence();
+    }
+    else {
+      slot.store(p, std::memory_order_seq_cst);
+    }
+  }
+
   // Apply the function f to every currently announced handle
   template<typename F>
   void scan_slots(F &&f) {
-    std::atomic_thread_fence(std::memory_order_seq_cst);
-    for (const auto &announcement_slot : announcement_slots) {
+    if (asymmetric_fences && light_announcements) utils::heavy_fence();
+    else std::atomic_thread_fence(std::memory_order_seq_cst);
+    auto nt = utils::num_thread_ids();
+    for (size_t i = 0; i < nt; i++) {
+      const auto &announcement_slot = announcement_slots[i];
       auto x = announcement_slot.announcement.load(std::memory_order_seq_cst);
       if (x != nullptr) f(x);
       for (const auto &free_slot : announcement_slot.snapshot_announcements) {
@@ -273,65 +344,102 @@ struct acquire_retire : public memory_manager_base<T, acquire_retire<T, snapshot
     }
   }
 
-  void work_toward_deferred_decrements(size_t work = 1) {
-    auto id = utils::threadID.getTID();
-    amortized_work[id] = amortized_work[id] + work;
-    auto threshold = std::max<size_t>(30, eject_delay * amortized_work.size());  // Always attempt at least 30 ejects
-    while (!in_progress[id] && amortized_work[id] >= threshold) {
-      amortized_work[id] = 0;
-      if (deferred_destructs[id].size() == 0) break; // nothing to collect
-      in_progress[id] = true;
-      auto deferred = AlignedVector<std::pair<counted_ptr_t,RetireType>>(std::move(deferred_destructs[id]));
-
-      // We need a custom hash because the standard doesn't know how to hash enum types...
-      struct Hash {
-        std::size_t operator()(std::pair<counted_ptr_t, RetireType> t) const {
-          return std::hash<counted_ptr_t>{}(t.first) ^ std::hash<std::size_t>{}(static_cast<std::size_t>(t.second));
-        }
-      };
-
-      // Since there can be multiple kinds of deferred actions (delayed ejects), each announcement
-      // needs to be able to protect each kind of action, since announcements do not specify which
-      // actions they wish to protect against.
-      std::unordered_map<std::pair<counted_ptr_t, RetireType>, unsigned int, Hash> announced;
-      scan_slots([&](auto reserved) {
-        for (size_t i = 0; i < num_retire_types; i++) {
-          // The first announcement needs to protect up to two actions
-          auto& cnt = announced[std::make_pair(reserved, static_cast<RetireType>(i))];
-          if (cnt) cnt++;
-          else cnt = 2;
-        }
-      });
-
-      // For a given deferred decrement, we first check if it is announced, and, if so,
-      // we defer it again. If it is not announced, it can be safely applied. If an
-      // object is deferred / announced multiple times, each announcement only protects
-      // against one of the deferred decrements, so for each object, the amount of
-      // decrements applied in total will be #deferred - #announced
-      auto f = [this, &announced](const auto& x) {
-        auto it = announced.find(x);
-        if (it == announced.end()) {
-          eject(x.first, x.second);
-          return true;
-        } else {
-          if (--(it->second) == 0) announced.erase(it);
-          return false;
-        }
-      };
+  bool any_deferred_destructs() {
+    auto nt = utils::num_thread_ids();
+    for (size_t i = 0; i < nt; i++) {
+      if (!deferred_destructs[i].empty()) return true;
+    }
+    return !handed_off.empty() || any_queued_ejects();
+  }
 
-      // Remove the deferred decrements that are successfully applied
-      deferred.erase(remove_if(deferred.begin(), deferred.end(), f), deferred.end());
-      deferred_destructs[id].insert(deferred_destructs[id].end(), deferred.begin(), deferred.end());
-      in_progress[id] = false;
+  // Collect the currently announced handles into the thread-local announcement
+  // index, sorted by address with duplicates collapsed into a single entry.
+  //
+  // Since there can be multiple kinds of deferred actions (delayed ejects), each announcement
+  // needs to be able to protect each kind of action, since announcements do not specify which
+  // actions they wish to protect against. The first announcement of a handle needs to protect
+  // up to two actions, so a handle announced k times protects k+1 actions of each kind.
+  AlignedVector<AnnouncedEntry>& build_announced_index(size_t id) {
+    auto& announced = announced_index[id];
+    announced.clear();
+    scan_slots([&](auto reserved) { announced.push_back(AnnouncedEntry{reserved, {}}); });
+    std::sort(announced.begin(), announced.end(), [](const AnnouncedEntry& a, const AnnouncedEntry& b) {
+      return std::less<counted_ptr_t>{}(a.ptr, b.ptr);
+    });
+    size_t n = 0;
+    for (size_t i = 0, j = 0; i < announced.size(); i = j) {
+      while (j < announced.size() && announced[j].ptr == announced[i].ptr) j++;
+      announced[n].ptr = announced[i].ptr;
+      announced[n].remaining.fill(static_cast<unsigned int>(j - i + 1));
+      n++;
     }
+    announced.resize(n);
+    return announced;
   }
 
-  std::vector<LocalSlot> announcement_slots;          // Announcement array slots
-  std::vector<AlignedBool> in_progress;               // Local flags to prevent reentrancy while destructing
-  std::vector<AlignedVector<std::pair<counted_ptr_t, RetireType>>> deferred_destructs;   // Thread-local lists of pending deferred destructs
-  std::vector<AlignedInt> amortized_work;             // Amortized work to pay for ejecting deferred destructs
+  // Apply the deferred actions of the given thread that are no longer protected,
+  // after adopting any that exempt or exited threads have handed off, and return how many
+  // were applied. If the ejects of the type are bounded, examine at most limit of them,
+  // resuming the sweep in progress, which judges them by the announcements that were
+  // collected when it started, and queue those that are safe instead.
+  size_t eject_deferred(size_t id, size_t limit = unlimited_sweep) {
+    auto& list = deferred_destructs[id];
+    bool resume = resume_sweep(list, limit);
+    if (!resume) {
+      skip_retires(id, list.adopt(handed_off));
+      if (list.size() == 0) return 0; // nothing to collect
+    }
+    in_progress[id] = true;
+    auto pass = begin_pass(id, list.size());
+    auto& announced = resume ? announced_index[id] : build_announced_index(id);
+
+    // For a given deferred decrement, we first check if it is announced, and, if so,
+    // we defer it again. If it is not announced, it can be safely applied. If an
+    // object is deferred / announced multiple times, each announcement only protects
+    // against one of the deferred decrements, so for each object, the amount of
+    // decrements applied in total will be #deferred - #announced
+    auto is_protected = [&announced](const auto& x) {
+      auto [ptr, type] = x.unpack();
+      auto it = std::lower_bound(announced.begin(), announced.end(), ptr,
+        [](const AnnouncedEntry& e, counted_ptr_t p) { return std::less<counted_ptr_t>{}(e.ptr, p); });
+      if (it == announced.end() || it->ptr != ptr || it->remaining[static_cast<size_t>(type)] == 0) {
+        return false;
+      } else {
+        it->remaining[static_cast<size_t>(type)]--;
+        return true;
+      }
+    };
+
+    // Apply the deferred decrements that are no longer protected, coalescing
+    // duplicates of the same object, and keep the remaining ones for later
+    auto key = [](const auto& x) { return x.unpack(); };
+    size_t ejected;
+    if constexpr (bounded_ejects) {
+      ejected = list.sweep_some(limit, [&is_protected](const auto& x, uint64_t) { return is_protected(x); },
+                                [this, key](const auto& x) { queue_eject(x, key); });
+    }
+    else {
+      ejected = list.sweep(is_protected, [this, key](auto first, auto last) { eject_ready(first, last, key); });
+    }
+    end_pass(pass, ejected);
+    in_progress[id] = false;
+    return ejected;
+  }
+
+  utils::PerThreadArray<LocalSlot> announcement_slots;          // Announcement array slots
+  utils::PerThreadArray<AlignedBool> in_progress;               // Local flags to prevent reentrancy while destructing
+  utils::PerThreadArray<retire_list<retired_ptr>> deferred_destructs;    // Thread-local lists of pending deferred destructs
+  typename retire_list<retired_ptr>::handoff handed_off;                 // Deferred actions handed off by exempt and exited threads
+  utils::PerThreadArray<AlignedVector<AnnouncedEntry>> announced_index;   // Thread-local buffers of announced handles, reused by every eject
+  utils::PerThreadArray<AlignedInt> eject_work;                 // Amortized work to pay for ejecting deferred destructs
+  allocator_type allocator;                                     // Allocates and frees the managed objects
+  const bool light_announcements = asymmetric_fences && utils::register_asymmetric_fences();
 };
 
+// Hazard-pointer backend that uses asymmetric (membarrier) fences
+template<typename T>
+using acquire_retire_membarrier = acquire_retire<T, 7, 2, true>;
+
 }  // namespace internal
 
 }  // namespace cdrc
@@ -15,6 +15,8 @@
 #include "../counted_object.h"
 #include "../epoch_tracker.h"
 #include "../memory_manager_base.h"
+#include "../retire_list.h"
+#include "../slab_allocator.h"
 #include "../utils.h"
 
 namespace cdrc {
@@ -40,56 +42,79 @@ namespace internal {
 //                   will reduce performance but decrease memory usage.
 // eject_delay =     The maximum number of deferred ejects that will be held by
 //                   any one worker thread is at most eject_delay * #threads.
+// Allocator =       The policy used to allocate the managed objects, either
+//                   new_delete_allocator or slab_allocator.
 //
-template<typename T, size_t epoch_frequency = 10, size_t eject_delay = 2>
-struct acquire_retire_ebr : public memory_manager_base<T, acquire_retire_ebr<T>> {
+template<typename T, size_t epoch_frequency = 10, size_t eject_delay = 2, template<typename> typename Allocator = new_delete_allocator>
+struct acquire_retire_ebr : public memory_manager_base<T, acquire_retire_ebr<T, epoch_frequency, eject_delay, Allocator>> {
 
-  using base = memory_manager_base<T, acquire_retire_ebr<T>>;
+  using base = memory_manager_base<T, acquire_retire_ebr<T, epoch_frequency, eject_delay, Allocator>>;
 
   using base::increment_allocations;
   using base::decrement_allocations;
   using base::increment_ref_cnt;
   using base::eject;
+  using base::eject_ready;
+  using base::queue_eject;
+  using base::resume_sweep;
+  using base::bounded_ejects;
+  using base::unlimited_sweep;
+  using base::apply_queued_ejects;
+  using base::any_queued_ejects;
+  using base::release_immortals;
+  using base::take_queued_ejects;
+  using base::flush_queued_ejects;
+  using base::arm_thread_exit_hook;
+  using base::work_toward_ejects;
+  using base::hand_off_deferred;
+  using base::skip_retires;
+  using base::begin_pass;
+  using base::end_pass;
+  using base::record_epoch_advance;
   using base::decrement_weak_cnt;
 
 private:
   using counted_object_t = counted_object<T>;
   using counted_ptr_t = std::add_pointer_t<counted_object_t>;
+  using retired_ptr = typename base::retired_ptr;
+
+  // The base class schedules the passes over deferred_destructs with eject_work, and
+  // makes them with advance_epoch and eject_deferred
+  friend base;
+  constexpr static size_t eject_delay_per_thread = eject_delay;
+
+  // A thread stalled inside a critical section holds back every deferred action retired since,
+  // so no number of passes could keep the pending actions under a hard limit
+  static_assert(base::hard_deferred_limit == 0,
+    "EBR can not honor a hard limit on deferred actions; use a backend that keeps freeing what a stalled thread does not protect, such as IBR, HE or hazard pointers");
 
 public:
 
   static acquire_retire_ebr& instance() {
-    static acquire_retire_ebr ar{utils::num_threads()};
+    static acquire_retire_ebr ar;
     return ar;
   }
 
+  // The allocator policy used for the managed objects
+  using allocator_type = Allocator<counted_object_t>;
+
   template<typename... Args>
   counted_ptr_t create_object(Args &&... args) {
     increment_allocations();
     work_toward_advancing_epoch(1);
-    return new counted_object_t(std::forward<Args>(args)...);
+    return allocator.create(std::forward<Args>(args)...);
   }
 
   void delete_object(counted_ptr_t p) {
-    delete p;
+    allocator.destroy(p);
     decrement_allocations();
   }
 
-  struct RetiredObj {
-    counted_ptr_t obj; uint64_t retireTS; RetireType type;
-    RetiredObj(counted_ptr_t obj, uint64_t ts, RetireType type_) : obj(obj), retireTS(ts), type(type_) {}
-  };
 
   template<typename U>
   using acquired_pointer = basic_acquired_pointer<U>;
 
-  explicit acquire_retire_ebr(size_t num_threads_) :
-    base(num_threads_),
-    num_threads(num_threads_),
-    in_progress(num_threads),
-    deferred_destructs(num_threads),
-    eject_work(num_threads),
-    epoch_work(num_threads) {}
+  acquire_retire_ebr() = default;
 
   template<typename U>
   [[nodiscard]] acquired_pointer<U> acquire(const std::atomic<U> *p) {
@@ -121,21 +146,41 @@ public:
 
   void retire(counted_ptr_t p, RetireType type) {
     auto id = utils::threadID.getTID();
-    deferred_destructs[id].emplace_back(p, epoch_tracker::instance().get_current_epoch(), type);
-    work_toward_ejects(1);
+    arm_thread_exit_hook();
+    deferred_destructs[id].push_back(retired_ptr(p, type), epoch_tracker::instance().get_current_epoch());
+    work_toward_ejects(id);
+  }
+
+  // Called by the exit hook of a thread that has retired objects. Applies the ejects that
+  // it has queued, and hands the rest of its deferred actions off to the remaining threads,
+  // which adopt them in their next pass.
+  void thread_exit() {
+    auto id = utils::threadID.getTID();
+    flush_queued_ejects();
+    hand_off_deferred(id);
+  }
+
+  // Called before each pass of drain. Advances the epoch, so that the actions retired in the
+  // current epoch become safe to apply once the threads in guards have moved past it.
+  void prepare_drain_pass(size_t id) {
+    advance_epoch(id);
   }
 
   // Perform any remaining deferred destruction. Need to be very careful
   // about additional objects being queued for deferred destruction by
   // an object that was just destructed.
   ~acquire_retire_ebr() {
-    in_progress.assign(in_progress.size(), true);
+    auto nt = utils::num_thread_ids();
+    for (size_t i = 0; i < nt; i++) in_progress[i] = true;
 
     // Loop because the destruction of one object could trigger the deferred
     // destruction of another object (possibly even in another thread), and
-    // so on recursively.
-    while (std::any_of(deferred_destructs.begin(), deferred_destructs.end(),
-                       [](const auto &v) { return !v.empty(); })) {
+    // so on recursively. The immortal objects are only released once nothing
+    // deferred can still refer to them.
+    while (any_deferred_destructs() || release_immortals()) {
+
+      // The actions handed off by exempt and exited threads are collected along with the rest
+      deferred_destructs[utils::threadID.getTID()].adopt(handed_off);
 
       // Move all of the contents from the deferred destruction lists
       // into a single local list. We don't want to just iterate the
@@ -143,12 +188,14 @@ public:
       // deferred destruction to be added to one of the lists, which
       // would invalidate its iterators
       std::vector<std::pair<counted_ptr_t,RetireType>> destructs;
-      for (auto &v : deferred_destructs) {
+      for (size_t i = 0; i < nt; i++) {
+        auto &v = deferred_destructs[i];
         for (const auto& x : v) {
-          destructs.emplace_back(x.obj, x.type);
+          destructs.push_back(x.unpack());
         }
         v.clear();
       }
+      take_queued_ejects(destructs);
 
       // Perform all of the pending deferred ejects
       for (auto [x,type] : destructs) {
@@ -159,46 +206,71 @@ public:
 
 private:
 
+  bool any_deferred_destructs() {
+    auto nt = utils::num_thread_ids();
+    for (size_t i = 0; i < nt; i++) {
+      if (!deferred_destructs[i].empty()) return true;
+    }
+    return !handed_off.empty() || any_queued_ejects();
+  }
+
   void work_toward_advancing_epoch(size_t work = 1) {
     auto id = utils::threadID.getTID();
     epoch_work[id] = epoch_work[id] + work;
-    if(epoch_work[id] >= epoch_frequency * num_threads) {
+    if(epoch_work[id] >= epoch_frequency * utils::num_thread_ids()) {
       epoch_work[id] = 0;
       epoch_tracker::instance().advance_global_epoch();
+      record_epoch_advance(id);
     }
   }
 
-  void work_toward_ejects(size_t work = 1) {
-    auto id = utils::threadID.getTID();
-    eject_work[id] = eject_work[id] + work;
-    auto threshold = std::max<size_t>(30, eject_delay * num_threads);  // Always attempt at least 30 ejects
-    while (!in_progress[id] && eject_work[id] >= threshold) {
-      eject_work[id] = 0;
-      if (deferred_destructs[id].size() == 0) break; // nothing to collect
-      in_progress[id] = true;
-      auto deferred = std::vector<RetiredObj>(std::move(deferred_destructs[id]));
-      auto min_epoch = epoch_tracker::instance().get_min_announced_epoch();
-
-      auto f = [this, min_epoch](const auto& x) {
-        if (x.retireTS < min_epoch) {
-          eject(x.obj, x.type);
-          return true;
-        }
-        return false;
-      };
+  // Advance the epoch right away, for the passes that the limits on deferred actions and
+  // drain force before enough objects have been created to advance it
+  void advance_epoch(size_t id) {
+    epoch_tracker::instance().advance_global_epoch();
+    record_epoch_advance(id);
+  }
 
-      // Remove the deferred decrements that are successfully applied
-      deferred.erase(remove_if(deferred.begin(), deferred.end(), f), deferred.end());
-      deferred_destructs[id].insert(deferred_destructs[id].end(), deferred.begin(), deferred.end());
-      in_progress[id] = false;
+  // Apply the deferred actions of the given thread that are no longer protected,
+  // after adopting any that exempt or exited threads have handed off, and return how many
+  // were applied. If the ejects of the type are bounded, examine at most limit of them,
+  // resuming the sweep in progress, and queue those that are safe instead.
+  size_t eject_deferred(size_t id, size_t limit = unlimited_sweep) {
+    auto& list = deferred_destructs[id];
+    bool resume = resume_sweep(list, limit);
+    if (!resume) {
+      skip_retires(id, list.adopt(handed_off));
+      if (list.size() == 0) return 0; // nothing to collect
+    }
+    in_progress[id] = true;
+    auto pass = begin_pass(id, list.size());
+    auto min_epoch = epoch_tracker::instance().get_min_announced_epoch();
+
+    // Apply the deferred decrements that were retired before the oldest announced
+    // epoch, coalescing duplicates of the same object, and keep the remaining ones
+    // for later. The list is stamped with the retire epochs, so the entries that
+    // are safe to eject are found a whole chunk at a time, except by a resumable sweep.
+    // The oldest announced epoch only grows, so the sweep reads it afresh each time.
+    auto key = [](const auto& x) { return x.unpack(); };
+    size_t ejected;
+    if constexpr (bounded_ejects) {
+      ejected = list.sweep_some(limit, [min_epoch](const auto&, uint64_t epoch) { return epoch >= min_epoch; },
+                                [this, key](const auto& x) { queue_eject(x, key); });
+    }
+    else {
+      ejected = list.sweep_stamped_before(min_epoch, [this, key](auto first, auto last) { eject_ready(first, last, key); });
     }
+    end_pass(pass, ejected);
+    in_progress[id] = false;
+    return ejected;
   }
 
-  size_t num_threads;
-  std::vector<AlignedBool> in_progress;                         // Local flags to prevent reentrancy while destructing
-  std::vector<AlignedVector<RetiredObj>> deferred_destructs;    // Thread-local lists of pending deferred destructs
-  std::vector<AlignedInt> eject_work;                           // Amortized work to pay for ejecting deferred destructs
-  std::vector<AlignedInt> epoch_work;                           // Amortized work to pay for incrementing the epoch
+  utils::PerThreadArray<AlignedBool> in_progress;                         // Local flags to prevent reentrancy while destructing
+  utils::PerThreadArray<retire_list<retired_ptr>> deferred_destructs;    // Thread-local lists of pending deferred destructs
+  typename retire_list<retired_ptr>::handoff handed_off;                 // Deferred actions handed off by exempt and exited threads
+  utils::PerThreadArray<AlignedInt> eject_work;                           // Amortized work to pay for ejecting deferred destructs
+  utils::PerThreadArray<AlignedInt> epoch_work;                           // Amortized work to pay for incrementing the epoch
+  allocator_type allocator;                                               // Allocates and frees the managed objects
 };
 
 
@@ -0,0 +1,470 @@
+#ifndef CDRC_SMR_ACQUIRE_RETIRE_HE_H
+#define CDRC_SMR_ACQUIRE_RETIRE_HE_H
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "../counted_object.h"
+#include "../memory_manager_base.h"
+#include "../pmr_allocator.h"
+#include "../retire_list.h"
+#include "../slab_allocator.h"
+#include "../utils.h"
+
+namespace cdrc {
+
+namespace internal {
+
+// An interface for safe memory reclamation that protects reference-counted
+// resources by deferring their reference count decrements until no thread
+// is still reading them.
+//
+// This implementation uses hazard eras. Like hazard pointers, no guard is
+// required, and each read is protected by an announcement slot, but instead
+// of announcing the handle itself, a thread announces the era in which the
+// read took place. The announcement only needs to be written (with a full
+// fence) when the global era has changed since the slot was last written,
+// so most reads are as cheap as they are with EBR. Every object records the
+// era of its creation, and a deferred action on it may be applied once no
+// announced era lies between its birth era and the era in which it was
+// retired. Announcements are left in place until the thread exits, and a
+// stalled thread can only delay the reclamation of objects that were alive in
+// the eras that it announced, rather than everything retired after it stalls.
+//
+// T =              The underlying type of the object being protected
+// snapshot_slots = The number of additional announcement slots available for
+//                  snapshot pointers. More allows more snapshots to be alive
+//                  at a time, but makes reclamation slower
+// era_frequency =  How often to update the global era. More often (lower value)
+//                  will make reads slower but decrease memory usage.
+// eject_delay =    The maximum number of deferred ejects that will be held by
+//                  any one worker thread is at most eject_delay * #threads.
+// Allocator =      The policy used to allocate the managed objects, either
+//                  new_delete_allocator or slab_allocator.
+//
+template<typename T, size_t snapshot_slots = 7, size_t era_frequency = 40, size_t eject_delay = 2, template<typename> typename Allocator = new_delete_allocator>
+struct acquire_retire_he : public memory_manager_base<T, acquire_retire_he<T, snapshot_slots, era_frequency, eject_delay, Allocator>> {
+
+  using base = memory_manager_base<T, acquire_retire_he<T, snapshot_slots, era_frequency, eject_delay, Allocator>>;
+
+  using base::increment_allocations;
+  using base::decrement_allocations;
+  using base::increment_ref_cnt;
+  using base::eject;
+  using base::eject_ready;
+  using base::queue_eject;
+  using base::resume_sweep;
+  using base::bounded_ejects;
+  using base::unlimited_sweep;
+  using base::apply_queued_ejects;
+  using base::any_queued_ejects;
+  using base::release_immortals;
+  using base::take_queued_ejects;
+  using base::flush_queued_ejects;
+  using base::arm_thread_exit_hook;
+  using base::work_toward_ejects;
+  using base::hand_off_deferred;
+  using base::skip_retires;
+  using base::begin_pass;
+  using base::end_pass;
+  using base::record_snapshot_overflow;
+  using base::record_epoch_advance;
+
+  inline static const uint64_t no_era = 0;
+
+ private:
+  using counted_object_t = counted_object<T>;
+  using counted_ptr_t = std::add_pointer_t<counted_object_t>;
+
+  // The base class schedules the passes over deferred_destructs with eject_work, and
+  // makes them with advance_epoch and eject_deferred
+  friend base;
+  constexpr static size_t eject_delay_per_thread = eject_delay;
+
+  // Slot 0 is used by acquire and reserve, and the rest by snapshots
+  constexpr static size_t num_slots = snapshot_slots + 1;
+
+  // Align to cache line boundary to avoid false sharing
+  struct alignas(128) LocalSlot {
+    std::array<std::atomic<uint64_t>, num_slots> eras;
+    alignas(128) std::array<bool, num_slots> in_use{};    // Only accessed by the owner
+
+    LocalSlot() {
+      for (auto &e : eras) {
+        std::atomic_init(&e, no_era);
+      }
+    }
+  };
+
+ public:
+
+  static acquire_retire_he& instance() {
+    static acquire_retire_he ar;
+    return ar;
+  }
+
+  // Augments a reference-counted object with a birth era field that is
+  // initialized with the value of the current era when the object is created
+  struct stamped_counted_object : public counted_object<T> {
+    template<typename... Args>
+    explicit stamped_counted_object(uint64_t t, Args&&... args)
+      : counted_object<T>(std::forward<Args>(args)...), birthTS(t) {}
+    uint64_t birthTS;
+  };
+
+  uint64_t get_birth_timestamp(counted_ptr_t p) {
+    return static_cast<stamped_counted_object*>(p)->birthTS;
+  }
+
+  // The allocator policy used for the managed objects
+  using allocator_type = Allocator<stamped_counted_object>;
+
+  template<typename... Args>
+  counted_ptr_t create_object(Args &&... args) {
+    increment_allocations();
+    work_toward_advancing_era(1);
+    return create_stamped(allocator, global_era.load(std::memory_order_acquire), std::forward<Args>(args)...);
+  }
+
+  void delete_object(counted_ptr_t p) {
+    allocator.destroy(static_cast<stamped_counted_object*>(p));
+    decrement_allocations();
+  }
+
+  struct RetiredObj {
+    counted_ptr_t obj; uint64_t birthTS; uint64_t retireTS; RetireType type;
+    RetiredObj(counted_ptr_t obj, uint64_t birthTS, uint64_t retireTS, RetireType type) :
+        obj(obj), birthTS(birthTS), retireTS(retireTS), type(type) {}
+  };
+
+  // An RAII wrapper around an acquired handle. Automatically
+  // releases the slot when the wrapper goes out of scope. The
+  // announced era is left in place, so that the next read can
+  // reuse it if the global era has not changed.
+  template<typename U>
+  struct acquired_pointer {
+   public:
+    friend struct acquire_retire_he;
+
+    acquired_pointer() : value(nullptr), in_use(nullptr) {}
+
+    acquired_pointer(U value_, bool* in_use_) : value(value_), in_use(in_use_) {}
+
+    acquired_pointer(acquired_pointer&& other) noexcept : value(other.value), in_use(other.in_use) {
+      other.value = nullptr;
+      other.in_use = nullptr;
+    }
+
+    ~acquired_pointer() { clear_protection(); }
+
+    acquired_pointer& operator=(acquired_pointer&& other) noexcept {
+      value = other.value;
+      in_use = other.in_use;
+      other.value = nullptr;
+      other.in_use = nullptr;
+      return *this;
+    }
+
+    void swap(acquired_pointer &other) {
+      std::swap(value, other.value);
+      std::swap(in_use, other.in_use);
+    }
+
+    U& get() {
+      return value;
+    }
+
+    U get() const {
+      return value;
+    }
+
+    bool is_protected() const {
+      return in_use != nullptr && value != nullptr;
+    }
+
+    void clear_protection() {
+      if (value != nullptr && in_use != nullptr) {
+        *in_use = false;
+      }
+    }
+
+    void clear() {
+      clear_protection();
+      value = nullptr;
+      in_use = nullptr;
+    }
+
+   private:
+    U value;
+    bool* in_use;
+  };
+
+  acquire_retire_he() : global_era(1) {}
+
+  template<typename U>
+  [[nodiscard]] acquired_pointer<U> acquire(const std::atomic<U> *p) {
+    auto id = utils::threadID.getTID();
+    auto& slot = announcement_slots[id];
+    U result = protected_load(p, slot.eras[0]);
+    slot.in_use[0] = true;
+    return acquired_pointer<U>(result, &slot.in_use[0]);
+  }
+
+  // Like acquire, but assuming that the caller already has a
+  // copy of the handle and knows that it is protected
+  template<typename U>
+  [[nodiscard]] acquired_pointer<U> reserve(U p) {
+    auto id = utils::threadID.getTID();
+    auto& slot = announcement_slots[id];
+    announce_current_era(slot.eras[0]);
+    slot.in_use[0] = true;
+    return acquired_pointer<U>(p, &slot.in_use[0]);
+  }
+
+  // Dummy function for when we need to conditionally reserve
+  // something, but might need to reserve nothing
+  template<typename U>
+  [[nodiscard]] acquired_pointer<U> reserve_nothing() const {
+    return {};
+  }
+
+  template<typename U>
+  [[nodiscard]] acquired_pointer<U> protect_snapshot(const std::atomic<U> *p) {
+    auto id = utils::threadID.getTID();
+    auto& slot = announcement_slots[id];
+    auto i = get_free_slot(slot);
+
+    // If no snapshot slot is available, just increment the reference count
+    if (i == 0) {
+      record_snapshot_overflow();
+      while (true) {
+        auto a = acquire(p);
+        if (a.get() && increment_ref_cnt(a.get())) return acquired_pointer<U>(a.get(), nullptr);
+        else if (a.get() == nullptr || p->load() == a.get()) return acquired_pointer<U>(nullptr, nullptr);
+      }
+    }
+
+    U result = protected_load(p, slot.eras[i]);
+    if (result == nullptr || result->get_use_count() == 0) return acquired_pointer<U>(nullptr, nullptr);
+    slot.in_use[i] = true;
+    return acquired_pointer<U>(result, &slot.in_use[i]);
+  }
+
+  void release() {
+    auto id = utils::threadID.getTID();
+    announcement_slots[id].in_use[0] = false;
+  }
+
+  void retire(counted_ptr_t p, RetireType type) {
+    auto id = utils::threadID.getTID();
+    arm_thread_exit_hook();
+    deferred_destructs[id].push_back(RetiredObj(p, get_birth_timestamp(p), global_era.load(std::memory_order_acquire), type));
+    work_toward_ejects(id);
+  }
+
+  // Called by the exit hook of a thread that has retired objects or announced an era. Applies
+  // the ejects that it has queued, hands the rest of its deferred actions off to the remaining
+  // threads, which adopt them in their next pass, and withdraws its announcements.
+  void thread_exit() {
+    auto id = utils::threadID.getTID();
+    flush_queued_ejects();
+    hand_off_deferred(id);
+
+    withdraw_announcements(id);
+  }
+
+  // Called before each pass of drain. Withdraws the eras that the current thread has left
+  // announced in its unused slots, which would otherwise protect the objects that it retired.
+  void prepare_drain_pass(size_t id) {
+    withdraw_announcements(id);
+  }
+
+  // Perform any remaining deferred destruction. Need to be very careful
+  // about additional objects being queued for deferred destruction by
+  // an object that was just destructed.
+  ~acquire_retire_he() {
+    auto nt = utils::num_thread_ids();
+    for (size_t i = 0; i < nt; i++) in_progress[i] = true;
+
+    // Loop because the destruction of one object could trigger the deferred
+    // destruction of another object (possibly even in another thread), and
+    // so on recursively. The immortal objects are only released once nothing
+    // deferred can still refer to them.
+    while (any_deferred_destructs() || release_immortals()) {
+
+      // The actions handed off by exempt and exited threads are collected along with the rest
+      deferred_destructs[utils::threadID.getTID()].adopt(handed_off);
+
+      // Move all of the contents from the deferred destruction lists
+      // into a single local list. We don't want to just iterate the
+      // deferred lists because a destruction may trigger another
+      // deferred destruction to be added to one of the lists, which
+      // would invalidate its iterators
+      std::vector<std::pair<counted_ptr_t,RetireType>> destructs;
+      for (size_t i = 0; i < nt; i++) {
+        auto &v = deferred_destructs[i];
+        for (const auto& x : v) {
+          destructs.emplace_back(x.obj, x.type);
+        }
+        v.clear();
+      }
+      take_queued_ejects(destructs);
+
+      // Perform all of the pending deferred ejects
+      for (auto [x,type] : destructs) {
+        eject(x,type);
+      }
+    }
+  }
+
+ private:
+
+  // Load the value of p, making sure that the era that was current at the time
+  // of the load is announced in the given slot before the value is returned
+  template<typename U>
+  U protected_load(const std::atomic<U> *p, std::atomic<uint64_t>& slot) {
+    auto prev_era = slot.load(std::memory_order_relaxed);
+    while (true) {
+      U result = p->load(std::memory_order_seq_cst);
+      auto cur_era = global_era.load(std::memory_order_seq_cst);
+      if (cur_era == prev_era) return result;
+      arm_thread_exit_hook();
+      slot.store(cur_era, std::memory_order_seq_cst);
+      prev_era = cur_era;
+    }
+  }
+
+  void announce_current_era(std::atomic<uint64_t>& slot) {
+    auto prev_era = slot.load(std::memory_order_relaxed);
+    while (true) {
+      auto cur_era = global_era.load(std::memory_order_seq_cst);
+      if (cur_era == prev_era) return;
+      arm_thread_exit_hook();
+      slot.store(cur_era, std::memory_order_seq_cst);
+      prev_era = cur_era;
+    }
+  }
+
+  // Clear the eras announced in the slots of the given thread that are not in use. Eras are
+  // otherwise never unannounced, since the next read can often reuse them.
+  void withdraw_announcements(size_t id) {
+    auto& slot = announcement_slots[id];
+    for (size_t i = 0; i < num_slots; i++) {
+      if (!slot.in_use[i]) slot.eras[i].store(no_era, std::memory_order_release);
+    }
+  }
+
+  // Returns the index of a free snapshot slot, or zero if there are none
+  size_t get_free_slot(const LocalSlot& slot) {
+    for (size_t i = 1; i < num_slots; i++) {
+      if (!slot.in_use[i]) return i;
+    }
+    return 0;
+  }
+
+  bool any_deferred_destructs() {
+    auto nt = utils::num_thread_ids();
+    for (size_t i = 0; i < nt; i++) {
+      if (!deferred_destructs[i].empty()) return true;
+    }
+    return !handed_off.empty() || any_queued_ejects();
+  }
+
+  void work_toward_advancing_era(size_t work = 1) {
+    auto id = utils::threadID.getTID();
+    era_work[id] = era_work[id] + work;
+    if (era_work[id] >= era_frequency * utils::num_thread_ids()) {
+      era_work[id] = 0;
+      global_era.fetch_add(1);
+      record_epoch_advance(id);
+    }
+  }
+
+  // Collect every currently announced era into the thread-local buffer in sorted order
+  AlignedVector<uint64_t>& collect_announced_eras(size_t id) {
+    auto& announced = announced_eras[id];
+    announced.clear();
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    auto nt = utils::num_thread_ids();
+    for (size_t i = 0; i < nt; i++) {
+      for (const auto& e : announcement_slots[i].eras) {
+        auto era = e.load(std::memory_order_seq_cst);
+        if (era != no_era) announced.push_back(era);
+      }
+    }
+    std::sort(announced.begin(), announced.end());
+    return announced;
+  }
+
+  // Advance the era right away for a pass forced by the limits on deferred actions, so that
+  // new reservations stop covering the era in which the latest actions were retired
+  void advance_epoch(size_t id) {
+    era_work[id] = 0;
+    global_era.fetch_add(1);
+    record_epoch_advance(id);
+  }
+
+  // Apply the deferred actions of the given thread that are no longer protected,
+  // after adopting any that exempt or exited threads have handed off, and return how many
+  // were applied. If the ejects of the type are bounded, examine at most limit of them,
+  // resuming the sweep in progress, which judges them by the announcements that were
+  // collected when it started, and queue those that are safe instead.
+  size_t eject_deferred(size_t id, size_t limit = unlimited_sweep) {
+    auto& list = deferred_destructs[id];
+    bool resume = resume_sweep(list, limit);
+    if (!resume) {
+      skip_retires(id, list.adopt(handed_off));
+      if (list.size() == 0) return 0; // nothing to collect
+    }
+    in_progress[id] = true;
+    auto pass = begin_pass(id, list.size());
+    auto& announced = resume ? announced_eras[id] : collect_announced_eras(id);
+
+    // A deferred action is protected if any announced era lies within [birthTS, retireTS]
+    auto is_protected = [&announced](const auto& x) {
+      auto it = std::lower_bound(announced.begin(), announced.end(), x.birthTS);
+      return it != announced.end() && *it <= x.retireTS;
+    };
+
+    // Apply the deferred decrements that are no longer protected, coalescing
+    // duplicates of the same object, and keep the remaining ones for later
+    auto key = [](const auto& x) { return std::make_pair(x.obj, x.type); };
+    size_t ejected;
+    if constexpr (bounded_ejects) {
+      ejected = list.sweep_some(limit, [&is_protected](const auto& x, uint64_t) { return is_protected(x); },
+                                [this, key](const auto& x) { queue_eject(x, key); });
+    }
+    else {
+      ejected = list.sweep(is_protected, [this, key](auto first, auto last) { eject_ready(first, last, key); });
+    }
+    end_pass(pass, ejected);
+    in_progress[id] = false;
+    return ejected;
+  }
+
+  alignas(128) std::atomic<uint64_t> global_era;                            // The current era
+  utils::PerThreadArray<LocalSlot> announcement_slots;                      // Announcement array slots
+  utils::PerThreadArray<AlignedBool> in_progress;                           // Local flags to prevent reentrancy while destructing
+  utils::PerThreadArray<retire_list<RetiredObj>> deferred_destructs;       // Thread-local lists of pending deferred destructs
+  typename retire_list<RetiredObj>::handoff handed_off;                    // Deferred actions handed off by exempt and exited threads
+  utils::PerThreadArray<AlignedVector<uint64_t>> announced_eras;            // Thread-local buffers of announced eras, reused by every eject
+  utils::PerThreadArray<AlignedInt> eject_work;                             // Amortized work to pay for ejecting deferred destructs
+  utils::PerThreadArray<AlignedInt> era_work;                               // Amortized work to pay for incrementing the era
+  allocator_type allocator;                                                 // Allocates and frees the managed objects
+};
+
+
+}  // namespace internal
+
+}  // namespace cdrc
+
+#endif  // CDRC_SMR_ACQUIRE_RETIRE_HE_H
@@ -5,15 +5,20 @@
 #include <cassert>
 #include <cstdint>
 
+#include <array>
 #include <atomic>
 #include <functional>
 #include <memory>
+#include <new>
 #include <type_traits>
 #include <utility>
 #include <vector>
 
 #include "../counted_object.h"
 #include "../memory_manager_base.h"
+#include "../pmr_allocator.h"
+#include "../retire_list.h"
+#include "../slab_allocator.h"
 #include "../utils.h"
 
 namespace cdrc {
@@ -32,26 +37,57 @@ struct hyaline_tracker {
     };
     union {
       Node* next;           // SLOT: After retiring
-      std::function<void(void*)>* decrement;
+      void (*reclaim)(Node*);   // REFS: Applies the deferred actions of the batch
     };
     Node* blink;    // REFS: First SLOT node,
 
-    Node(void* obj) : obj(obj), bnext(nullptr), next(nullptr), blink(nullptr) {}
+    Node() : obj(nullptr), bnext(nullptr), next(nullptr), blink(nullptr) {}
+    explicit Node(void* obj) : obj(obj), bnext(nullptr), next(nullptr), blink(nullptr) {}
   };
 
   inline static Node* invptr = reinterpret_cast<Node*>(0x1);
   inline static const int64_t REFC_PROTECT = (1ull << 62);
 
+  // Nodes are carved out of slabs and recycled through per-thread caches, so
+  // that retiring an object does not cost a heap allocation. Free nodes are
+  // linked through bnext. A thread whose cache grows too large (because it
+  // frees more nodes than it retires) hands a chunk of them to a shared list,
+  // from which threads with an empty cache take them before allocating a new slab.
+  constexpr static size_t slab_size = 512;
+  constexpr static size_t max_cached_nodes = 4 * slab_size;
+
+  struct Slab {
+    Slab* next;
+    std::array<Node, slab_size> nodes;
+  };
+
+  struct alignas(128) NodeCache {
+    Node* free;
+    size_t size;
+    NodeCache() : free(nullptr), size(0) {}
+  };
+
+  // Eras are only used by the robust (Hyaline-S) variant. A batch records the
+  // earliest birth era of its objects, and a thread's reservation records the
+  // latest era in which it read a pointer during its current critical section.
+  // A batch is not attached to a thread whose era is earlier than the batch's
+  // birth era, since that thread can not hold a reference to any of its objects.
+  // Batches from the plain variant have a birth era of zero, so they are always
+  // attached, as are batches given to threads that use the plain variant.
+  inline static const uint64_t no_era = 0;
+
   struct alignas(128) Batch {
     Node* first;
     Node* refs;
     size_t counter;
-    Batch() : first(nullptr), refs(nullptr), counter(0) {}
+    uint64_t min_birth;
+    Batch() : first(nullptr), refs(nullptr), counter(0), min_birth(no_era) {}
   };
 
   struct alignas(128) Reservation {
     std::atomic<Node*> list;
-    Reservation() : list(invptr) {}
+    std::atomic<uint64_t> era;
+    Reservation() : list(invptr), era(no_era) {}
   };
 
   static hyaline_tracker &instance() {
@@ -64,6 +100,7 @@ struct hyaline_tracker {
     if (critical_section[id]) {
       return false;
     } else {
+      rsrv[id].era.store(no_era, std::memory_order_relaxed);
       rsrv[id].list.exchange(nullptr);
       critical_section[id] = true;
       return true;
@@ -84,14 +121,71 @@ struct hyaline_tracker {
     return critical_section[id];
   }
 
-  void add_batch(const Batch& batch) {
+  uint64_t get_current_era() {
+    return global_era.load(std::memory_order_acquire);
+  }
+
+  void advance_era() {
+    global_era.fetch_add(1);
+  }
+
+  // Load the value of p, making sure that the calling thread's reservation
+  // covers the era in which the load took place before it is returned
+  template<typename U>
+  U protected_load(const std::atomic<U>* p) {
+    auto id = utils::threadID.getTID();
+    auto& era = rsrv[id].era;
+    auto prev_era = era.load(std::memory_order_relaxed);
+    while (true) {
+      U result = p->load(std::memory_order_seq_cst);
+      auto cur_era = global_era.load(std::memory_order_seq_cst);
+      if (cur_era == prev_era) return result;
+      era.store(cur_era, std::memory_order_seq_cst);
+      prev_era = cur_era;
+    }
+  }
+
+  // Make sure that the calling thread's reservation covers the current era
+  void protect_current_era() {
+    auto id = utils::threadID.getTID();
+    auto& era = rsrv[id].era;
+    auto cur_era = global_era.load(std::memory_order_seq_cst);
+    if (era.load(std::memory_order_relaxed) != cur_era) era.store(cur_era, std::memory_order_seq_cst);
+  }
+
+  Node* allocate_node(void* obj) {
+    auto id = utils::threadID.getTID();
+    auto& cache = node_cache[id];
+    if (cache.free == nullptr) refill(cache);
+    Node* node = cache.free;
+    cache.free = node->bnext;
+    cache.size--;
+    return new (node) Node(obj);
+  }
+
+  void free_node(Node* node) {
+    auto id = utils::threadID.getTID();
+    auto& cache = node_cache[id];
+    node->bnext = cache.free;
+    cache.free = node;
+    cache.size++;
+    if (cache.size >= max_cached_nodes) spill(cache);
+  }
+
+  // Attach the batch to the reservation lists of the first nt thread IDs.
+  // The batch must contain at least nt+1 nodes. Threads that register an
+  // ID after nt was read can not have observed the retired objects, and
+  // neither can threads whose era is earlier than the batch's birth era.
+  void add_batch(const Batch& batch, size_t nt) {
+    assert(batch.counter > nt);
     batch.refs->blink = batch.first;
     Node* curr = batch.first;
     int64_t cnt = -REFC_PROTECT;
-    for(size_t i = 0; i < utils::num_threads(); i++) {
+    for(size_t i = 0; i < nt; i++) {
       while(true) {
         Node* prev = rsrv[i].list.load();
         if(prev == invptr) break;
+        if(rsrv[i].era.load() < batch.min_birth) break;
         curr->next = prev;
         if(rsrv[i].list.compare_exchange_strong(prev, curr)) {
           cnt++;
@@ -116,25 +210,74 @@ private:
   }
 
   void free_batch(Node* refs) {
-    std::function<void(void*)>& decrement = *(refs->decrement);
-    Node* n = refs->blink;
+    refs->reclaim(refs);
+  }
+
+  // Move slab_size nodes from the given cache to the shared list
+  void spill(NodeCache& cache) {
+    Node* chunk = cache.free;
+    Node* last = chunk;
+    for (size_t i = 1; i < slab_size; i++) last = last->bnext;
+    cache.free = last->bnext;
+    cache.size -= slab_size;
+    last->bnext = nullptr;
+    push_chunks(chunk, chunk);
+  }
+
+  // Push a list of chunks, linked through next, to the shared list
+  void push_chunks(Node* first, Node* last) {
+    Node* head = shared_chunks.load(std::memory_order_relaxed);
     do {
-      Node* node = n;
-      // refc and bnext overlap and are 0
-      // (nullptr) for the last REFS node
-      assert(n != invptr);
-      n = n->bnext;
-      decrement(node->obj);
-      delete node;
-    } while(n != nullptr);
+      last->next = head;
+    } while (!shared_chunks.compare_exchange_weak(head, first, std::memory_order_release, std::memory_order_relaxed));
+  }
+
+  // Refill an empty cache with a chunk from the shared list, or with a new slab
+  // if there are none. The shared list is only ever emptied by exchange, and never
+  // popped from, so it is not susceptible to ABA.
+  void refill(NodeCache& cache) {
+    assert(cache.free == nullptr);
+    Node* chunks = shared_chunks.exchange(nullptr, std::memory_order_acquire);
+    if (chunks != nullptr) {
+      Node* rest = chunks->next;
+      if (rest != nullptr) {
+        Node* last = rest;
+        while (last->next != nullptr) last = last->next;
+        push_chunks(rest, last);
+      }
+      cache.free = chunks;
+      cache.size = slab_size;
+    }
+    else {
+      auto slab = new Slab;
+      for (size_t i = 0; i + 1 < slab_size; i++) slab->nodes[i].bnext = &slab->nodes[i + 1];
+      cache.free = &slab->nodes[0];
+      cache.size = slab_size;
+      slab->next = slabs.load(std::memory_order_relaxed);
+      while (!slabs.compare_exchange_weak(slab->next, slab)) {}
+    }
   }
 
 public:
-  hyaline_tracker() : critical_section(utils::num_threads()),
-                      rsrv(utils::num_threads()) {}
+  hyaline_tracker() : global_era(1), shared_chunks(nullptr), slabs(nullptr) {}
+
+  ~hyaline_tracker() {
+    Slab* slab = slabs.load();
+    while (slab != nullptr) {
+      Slab* next = slab->next;
+      delete slab;
+      slab = next;
+    }
+  }
 
-  std::vector<utils::Padded<bool>> critical_section;
-  std::vector<Reservation> rsrv;
+  utils::PerThreadArray<utils::Padded<bool>> critical_section;
+  utils::PerThreadArray<Reservation> rsrv;
+
+private:
+  utils::PerThreadArray<NodeCache> node_cache;
+  alignas(128) std::atomic<uint64_t> global_era;
+  alignas(128) std::atomic<Node*> shared_chunks;
+  alignas(128) std::atomic<Slab*> slabs;
 };
 
 }  // namespace internal
@@ -180,19 +323,39 @@ namespace internal {
 //     // critical code
 //   }
 //
+// In the plain variant, a thread that stalls inside a guard pins every batch
+// that is retired after it entered. The robust variant (Hyaline-S) stamps
+// each object with the era of its creation, and has reads announce the era
+// in which they took place, so that batches whose objects were all created
+// after a stalled thread's last read are not attached to it.
+//
 // T =              The underlying type of the object being protected
 // batch_size       accumulate (batch_size*num_threads)+1 nodes before announcing batch
+// robust =         Use birth eras to bound the memory pinned by stalled threads
+// era_frequency =  (robust only) How often to update the global era. More often
+//                  (lower value) will make reads slower but decrease memory usage.
+// Allocator =      The policy used to allocate the managed objects, either
+//                  new_delete_allocator or slab_allocator.
 //
 // NOTE: handling recursion was tricky
 // Note: Hyaline doesn't suffer as much from the recursive destruct problem. No maybe it
 // still does because batching. But it might be easier to fix.
-template<typename T, size_t batch_size = 2>
-struct acquire_retire_hyaline : public memory_manager_base<T, acquire_retire_hyaline<T>> {
+template<typename T, size_t batch_size = 2, bool robust = false, size_t era_frequency = 40, template<typename> typename Allocator = new_delete_allocator>
+struct acquire_retire_hyaline : public memory_manager_base<T, acquire_retire_hyaline<T, batch_size, robust, era_frequency, Allocator>> {
 
-  using base = memory_manager_base<T, acquire_retire_hyaline<T>>;
+  using base = memory_manager_base<T, acquire_retire_hyaline<T, batch_size, robust, era_frequency, Allocator>>;
 
   using base::increment_allocations;
   using base::decrement_allocations;
+  using base::eject;
+  using base::arm_thread_exit_hook;
+  using base::record_batch;
+  using base::record_batch_ejects;
+  using base::skip_batch_retires;
+  using base::count_batch_retires;
+  using base::publish_batch_stats;
+  using base::record_epoch_advance;
+  using base::release_immortals;
 
   using Node = hyaline_tracker::Node;
   using Batch = hyaline_tracker::Batch;
@@ -201,58 +364,117 @@ private:
   using counted_object_t = counted_object<T>;
   using counted_ptr_t = std::add_pointer_t<counted_object_t>;
 
+  // The base class makes the passes of drain with in_progress and eject_deferred
+  friend base;
+
+  // Objects are freed a whole batch at a time once every thread that could hold a reference
+  // has left, so there are no passes that the limits on deferred actions could force
+  static_assert(!base::limits_deferred, "Hyaline can not honor limits on deferred actions");
+
+  // The retire type of each node is stored in the low bits of its object
+  // pointer, since a batch may contain deferred actions of different types
+  static_assert(alignof(counted_object_t) >= 4);
+  constexpr static uintptr_t retire_type_mask = 3;
+
+  static void* pack(counted_ptr_t p, RetireType type) {
+    return reinterpret_cast<void*>(reinterpret_cast<uintptr_t>(p) | static_cast<uintptr_t>(type));
+  }
+
+  static std::pair<counted_ptr_t, RetireType> unpack(void* obj) {
+    auto bits = reinterpret_cast<uintptr_t>(obj);
+    return {reinterpret_cast<counted_ptr_t>(bits & ~retire_type_mask), static_cast<RetireType>(bits & retire_type_mask)};
+  }
+
+  // Apply the deferred actions of every node in the batch whose REFS node is
+  // given and recycle the nodes. Batches are only ever formed from objects of
+  // a single backend, so the tracker reaches this through a plain function
+  // pointer stored in the REFS node, and each eject is a direct call. Nodes
+  // without an object only pad a batch that was added early by drain.
+  static void reclaim_batch(Node* refs) {
+    auto& ar = instance();
+    auto& tracker = hyaline_tracker::instance();
+    Node* n = refs->blink;
+    uint64_t applied = 0;                                // Only counted with CDRC_STATS
+    do {
+      Node* node = n;
+      // refc and bnext overlap and are 0
+      // (nullptr) for the last REFS node
+      assert(n != hyaline_tracker::invptr);
+      n = n->bnext;
+      auto [obj, type] = unpack(node->obj);
+      tracker.free_node(node);
+      if (obj != nullptr) {
+        if constexpr (stats_enabled) applied++;
+        ar.eject(obj, type);
+      }
+    } while(n != nullptr);
+    ar.record_batch_ejects(applied);
+  }
+
 public:
 
   static acquire_retire_hyaline& instance() {
-    static acquire_retire_hyaline ar{utils::num_threads()};
+    static acquire_retire_hyaline ar;
     return ar;
   }
 
+  // Augments a reference-counted object with a birth era field that is
+  // initialized with the value of the current era when the object is created
+  struct stamped_counted_object : public counted_object<T> {
+    template<typename... Args>
+    explicit stamped_counted_object(uint64_t t, Args&&... args)
+      : counted_object<T>(std::forward<Args>(args)...), birthTS(t) {}
+    uint64_t birthTS;
+  };
+
+  // Objects only carry a birth era in robust mode
+  using stored_object_t = std::conditional_t<robust, stamped_counted_object, counted_object_t>;
+
+  uint64_t get_birth_timestamp(counted_ptr_t p) {
+    return static_cast<stamped_counted_object*>(p)->birthTS;
+  }
+
+  // The allocator policy used for the managed objects
+  using allocator_type = Allocator<stored_object_t>;
+
   template<typename... Args>
   counted_ptr_t create_object(Args &&... args) {
     increment_allocations();
-    return new counted_object_t(std::forward<Args>(args)...);
+    if constexpr (robust) {
+      work_toward_advancing_era(1);
+      return create_stamped(allocator, hyaline_tracker::instance().get_current_era(), std::forward<Args>(args)...);
+    }
+    else {
+      return allocator.create(std::forward<Args>(args)...);
+    }
   }
 
   void delete_object(counted_ptr_t p) {
-    delete p;
+    allocator.destroy(static_cast<stored_object_t*>(p));
     decrement_allocations();
   }
 
   template<typename U>
   using acquired_pointer = basic_acquired_pointer<U>;
 
-  explicit acquire_retire_hyaline(size_t num_threads_) :
-    base(num_threads_),
-    num_threads(num_threads_),
-    local_batch(num_threads),
-    in_progress(num_threads, false)
+  acquire_retire_hyaline()
     {
       hyaline_tracker::instance();  // touch the tracker to force it to initialize before this object,
                                     // otherwise, destruction order may be wrong since acquire_retire_hyaline
                                     // refers to hyaline_tracker in its destructor, and hence hyaline tracker
                                     // MUST be destructed after (and hence constructed before!)
-
-      strong_eject = [this](void* obj) {
-        this->eject(reinterpret_cast<counted_ptr_t>(obj), RetireType::decrement_strong_count);
-      };
-      weak_eject = [this](void* obj) {
-        this->eject(reinterpret_cast<counted_ptr_t>(obj), RetireType::decrement_weak_count);
-      };
-      dispose_eject = [this](void* obj) {
-        this->eject(reinterpret_cast<counted_ptr_t>(obj), RetireType::dispose);
-      };
     }
 
   template<typename U>
   [[nodiscard]] acquired_pointer<U> acquire(const std::atomic<U> *p) {
-    return acquired_pointer<U>(p->load(std::memory_order_acquire));
+    return acquired_pointer<U>(load(p));
   }
 
   // Like acquire, but assuming that the caller already has a
   // copy of the handle and knows that it is protected
   template<typename U>
   [[nodiscard]] acquired_pointer<U> reserve(U p) {
+    if constexpr (robust) hyaline_tracker::instance().protect_current_era();
     return acquired_pointer<U>(p);
   }
 
@@ -265,7 +487,7 @@ public:
 
   template<typename U>
   [[nodiscard]] acquired_pointer<U> protect_snapshot(const std::atomic<U> *p) {
-    auto ptr = p->load(std::memory_order_acquire);
+    auto ptr = load(p);
     if (ptr != nullptr && ptr->get_use_count() == 0) ptr = nullptr;
     return {ptr};
   }
@@ -275,32 +497,60 @@ public:
   void retire(counted_ptr_t p, RetireType type) {
     auto id = utils::threadID.getTID();
     if(p == nullptr) {return;}
+    add_to_batch(id, p, type);
+  }
 
+  // Called by the exit hook of a thread that has retired objects. A partial batch can not be
+  // added until it has enough nodes, so the objects in it are handed off instead, and retired
+  // again by the next thread to retire an object.
+  void thread_exit() {
+    auto id = utils::threadID.getTID();
     Batch& batch = local_batch[id];
-    Node* node = new Node(reinterpret_cast<void*>(p));
-    if(!batch.first) { // the REFS node
-      batch.refs = node;
-      node->refc.store(hyaline_tracker::REFC_PROTECT, std::memory_order_release);
-      if (type == RetireType::decrement_strong_count) node->decrement = &strong_eject;
-      else if (type == RetireType::decrement_weak_count) node->decrement = &weak_eject;
-      else node->decrement = &dispose_eject;
-    } else { // SLOT nodes
-      node->blink = batch.refs; // points to REFS
-      node->bnext = batch.first;
+    if (batch.first != nullptr) record_batch(id, batch.counter);
+    publish_batch_stats(id);
+    if (batch.first == nullptr) return;
+    retire_list<void*> leftover;
+    Node* node = batch.first;
+    while (true) {
+      Node* next = node->bnext;
+      bool last = (node == batch.refs);
+      leftover.push_back(node->obj);
+      hyaline_tracker::instance().free_node(node);
+      if (last) break;
+      node = next;
     }
-    batch.first = node;
-    batch.counter++;
-    // Must have MAX_THREADS+1 nodes to insert to
-    // MAX_THREADS lists, exit if do not have enough
-    while(!in_progress[id] && batch.counter > batch_size*num_threads) {
-      const Batch batch_copy = batch;
-      batch.first = nullptr;
-      batch.counter = 0;
-      // if(in_progress) std::cout << "recursive call to retire" << std::endl;
-      in_progress[id] = true;
-      hyaline_tracker::instance().add_batch(batch_copy);
-      in_progress[id] = false;
+    batch.first = nullptr;
+    batch.counter = 0;
+    batch.min_birth = hyaline_tracker::no_era;
+    leftover.hand_off(orphans);
+  }
+
+  // One pass of drain. Retires the objects that exited threads have handed off, and then
+  // adds the partial batch of the given thread, padded with empty nodes until it has
+  // enough to be added. The batch is freed right away if no thread is in a guard, and
+  // otherwise by the last thread to leave its guard. Returns the number of objects in it.
+  size_t eject_deferred(size_t id) {
+    if (!orphans.empty()) adopt_orphans();
+    Batch& batch = local_batch[id];
+    if (batch.first == nullptr) return 0;
+    const size_t retired = batch.counter;
+    record_batch(id, retired);
+    auto nt = utils::num_thread_ids();
+    while (batch.counter <= nt) {
+      Node* node = hyaline_tracker::instance().allocate_node(nullptr);
+      node->blink = batch.refs;
+      node->bnext = batch.first;
+      batch.first = node;
+      batch.counter++;
     }
+    const Batch batch_copy = batch;
+    batch.first = nullptr;
+    batch.counter = 0;
+    batch.min_birth = hyaline_tracker::no_era;
+    in_progress[id] = true;
+    hyaline_tracker::instance().add_batch(batch_copy, nt);
+    in_progress[id] = false;
+    return retired;
   }
 
   // Perform any remaining deferred destruction. Need to be very careful
@@ -308,37 +558,130 @@ public:
   // an object that was just destructed.
   ~acquire_retire_hyaline() {
     auto id = utils::threadID.getTID();
+    bool released;
     do {
-      for (size_t i = 0; i < num_threads; i++) {
+      // No thread can still be reading the objects that exited threads left behind
+      retire_list<void*> adopted;
+      adopted.adopt(orphans);
+      for (auto obj : adopted) {
+        auto [p, type] = unpack(obj);
+        in_progress[id] = true;
+        eject(p, type);
+        in_progress[id] = false;
+      }
+      for (size_t i = 0; i < utils::num_thread_ids(); i++) {
         assert(hyaline_tracker::instance().rsrv[i].list.load() == hyaline_tracker::invptr);
         while(local_batch[i].first != nullptr) {
           Batch& batch = local_batch[i];
           const Batch batch_copy = batch;
           batch.first = nullptr;
           batch.counter = 0;
+          batch.min_birth = hyaline_tracker::no_era;
           Node* node = batch_copy.first;
           while(node != nullptr) {
             Node* next = node->bnext;
-            void* obj = node->obj;
+            auto [obj, type] = unpack(node->obj);
+            bool last = (node == batch_copy.refs);
+            hyaline_tracker::instance().free_node(node);
             in_progress[id] = true;
-            (*batch_copy.refs->decrement)(obj);
+            eject(obj, type);
             in_progress[id] = false;
-            delete node;
-            if(node == batch_copy.refs) break;
+            if(last) break;
             node = next;
           }
         }
       }
-    } while(local_batch[id].first != nullptr);
+      // The immortal objects are only released once nothing deferred can still refer to them
+      released = false;
+      if (local_batch[id].first == nullptr && orphans.empty()) {
+        in_progress[id] = true;
+        released = release_immortals();
+        in_progress[id] = false;
+      }
+    } while(released || local_batch[id].first != nullptr || !orphans.empty());
   }
 
 private:
-  alignas(128) size_t num_threads;
-  alignas(128) std::vector<Batch> local_batch;
-  alignas(128) std::function<void(void*)> strong_eject, weak_eject, dispose_eject;
-  std::vector<AlignedBool> in_progress;                         // Local flags to prevent reentrancy while destructing
+
+  // Add an object to the batch of the current thread, whose ID is given, and add the batch
+  // to the tracker once it has enough nodes. Objects that exited threads handed off are
+  // added here again without being counted as retired twice.
+  void add_to_batch(size_t id, counted_ptr_t p, RetireType type) {
+    arm_thread_exit_hook();
+
+    Batch& batch = local_batch[id];
+    Node* node = hyaline_tracker::instance().allocate_node(pack(p, type));
+    if(!batch.first) { // the REFS node
+      batch.refs = node;
+      node->refc.store(hyaline_tracker::REFC_PROTECT, std::memory_order_release);
+      node->reclaim = &reclaim_batch;
+      if constexpr (robust) batch.min_birth = get_birth_timestamp(p);
+    } else { // SLOT nodes
+      node->blink = batch.refs; // points to REFS
+      node->bnext = batch.first;
+      if constexpr (robust) batch.min_birth = std::min(batch.min_birth, get_birth_timestamp(p));
+    }
+    batch.first = node;
+    batch.counter++;
+    // Must have MAX_THREADS+1 nodes to insert to
+    // MAX_THREADS lists, exit if do not have enough
+    auto nt = utils::num_thread_ids();
+    while(!in_progress[id] && batch.counter > batch_size*nt) {
+      record_batch(id, batch.counter);
+      const Batch batch_copy = batch;
+      batch.first = nullptr;
+      batch.counter = 0;
+      batch.min_birth = hyaline_tracker::no_era;
+      // if(in_progress) std::cout << "recursive call to retire" << std::endl;
+      in_progress[id] = true;
+      hyaline_tracker::instance().add_batch(batch_copy, nt);
+      in_progress[id] = false;
+    }
+    if (!in_progress[id] && !orphans.empty()) adopt_orphans();
+  }
+
+  // Retire the objects that exited threads have handed off into the batch of the current
+  // thread. Their nodes belonged to the batches of the exited threads, so each gets a new one.
+  void adopt_orphans() {
+    retire_list<void*> adopted;
+    adopted.adopt(orphans);
+    auto id = utils::threadID.getTID();
+    for (auto obj : adopted) {
+      auto [p, type] = unpack(obj);
+      skip_batch_retires(1);
+      add_to_batch(id, p, type);
+    }
+  }
+
+  // The deferred actions of a thread are held in its partial batch
+  void count_held_retires(size_t id) { count_batch_retires(id, local_batch[id].counter); }
+
+  template<typename U>
+  U load(const std::atomic<U> *p) {
+    if constexpr (robust) return hyaline_tracker::instance().protected_load(p);
+    else return p->load(std::memory_order_acquire);
+  }
+
+  void work_toward_advancing_era(size_t work = 1) {
+    auto id = utils::threadID.getTID();
+    era_work[id] = era_work[id] + work;
+    if (era_work[id] >= era_frequency * utils::num_thread_ids()) {
+      era_work[id] = 0;
+      hyaline_tracker::instance().advance_era();
+      record_epoch_advance(id);
+    }
+  }
+
+  alignas(128) utils::PerThreadArray<Batch> local_batch;
+  utils::PerThreadArray<AlignedBool> in_progress;                         // Local flags to prevent reentrancy while destructing
+  retire_list<void*>::handoff orphans;                                    // Objects left in the partial batches of exited threads
+  utils::PerThreadArray<AlignedInt> era_work;                             // Amortized work to pay for incrementing the era
+  allocator_type allocator;                                               // Allocates and frees the managed objects
 };
 
+// Robust Hyaline (Hyaline-S) backend that uses birth eras
+template<typename T>
+using acquire_retire_hyaline_s = acquire_retire_hyaline<T, 2, true>;
 
 }  // namespace internal
 
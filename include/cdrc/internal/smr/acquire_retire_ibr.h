@@ -14,6 +14,9 @@
 #include "../counted_object.h"
 #include "../epoch_tracker.h"
 #include "../memory_manager_base.h"
+#include "../pmr_allocator.h"
+#include "../retire_list.h"
+#include "../slab_allocator.h"
 #include "../utils.h"
 
 namespace cdrc {
@@ -39,22 +42,47 @@ namespace internal {
 //                   will reduce performance but decrease memory usage.
 // eject_delay =     The maximum number of deferred ejects that will be held by
 //                   any one worker thread is at most eject_delay * #threads.
+// Allocator =       The policy used to allocate the managed objects, either
+//                   new_delete_allocator or slab_allocator.
 //
-template<typename T, size_t epoch_frequency = 40, size_t eject_delay = 2>
-struct acquire_retire_ibr : public memory_manager_base<T, acquire_retire_ibr<T, eject_delay>> {
+template<typename T, size_t epoch_frequency = 40, size_t eject_delay = 2, template<typename> typename Allocator = new_delete_allocator>
+struct acquire_retire_ibr : public memory_manager_base<T, acquire_retire_ibr<T, epoch_frequency, eject_delay, Allocator>> {
 
-  using base = memory_manager_base<T, acquire_retire_ibr<T, eject_delay>>;
+  using base = memory_manager_base<T, acquire_retire_ibr<T, epoch_frequency, eject_delay, Allocator>>;
 
   using base::increment_allocations;
   using base::decrement_allocations;
   using base::increment_ref_cnt;
   using base::eject;
+  using base::eject_ready;
+  using base::queue_eject;
+  using base::resume_sweep;
+  using base::bounded_ejects;
+  using base::unlimited_sweep;
+  using base::apply_queued_ejects;
+  using base::any_queued_ejects;
+  using base::release_immortals;
+  using base::take_queued_ejects;
+  using base::flush_queued_ejects;
+  using base::arm_thread_exit_hook;
+  using base::work_toward_ejects;
+  using base::hand_off_deferred;
+  using base::skip_retires;
+  using base::begin_pass;
+  using base::end_pass;
+  using base::record_epoch_advance;
 
   inline static const uint64_t INVALID_TS = 0;
 
  private:
   using counted_object_t = counted_object<T>;
   using counted_ptr_t = std::add_pointer_t<counted_object_t>;
+  using retired_ptr = typename base::retired_ptr;
+
+  // The base class schedules the passes over deferred_destructs with eject_work, and
+  // makes them with advance_epoch and eject_deferred
+  friend base;
+  constexpr static size_t eject_delay_per_thread = eject_delay;
 
   // Align to cache line boundary to avoid false sharing
   struct alignas(64) LocalSlot {
@@ -66,7 +94,7 @@ struct acquire_retire_ibr : public memory_manager_base<T, acquire_retire_ibr<T,
  public:
 
   static acquire_retire_ibr& instance() {
-    static acquire_retire_ibr ar{utils::num_threads()};
+    static acquire_retire_ibr ar;
     return ar;
   }
 
@@ -83,36 +111,35 @@ struct acquire_retire_ibr : public memory_manager_base<T, acquire_retire_ibr<T,
     return static_cast<stamped_counted_object*>(p)->birthTS;
   }
 
+  // The allocator policy used for the managed objects
+  using allocator_type = Allocator<stamped_counted_object>;
+
   template<typename... Args>
   counted_ptr_t create_object(Args &&... args) {
     increment_allocations();
     work_toward_advancing_epoch(1);
-    return new stamped_counted_object(epoch_tracker::instance().get_current_epoch(), std::forward<Args>(args)...);
+    return create_stamped(allocator, epoch_tracker::instance().get_current_epoch(), std::forward<Args>(args)...);
   }
 
   void delete_object(counted_ptr_t p) {
-    delete static_cast<stamped_counted_object*>(p);
+    allocator.destroy(static_cast<stamped_counted_object*>(p));
     decrement_allocations();
   }
 
+  // The retire type is packed into the object pointer, and the retire epoch is stored
+  // once per chunk of the deferred list as its stamp, so an entry fits in 16 bytes
   struct RetiredObj {
-    counted_ptr_t obj; uint64_t birthTS; uint64_t retireTS; RetireType type;
-    RetiredObj(counted_ptr_t obj, uint64_t birthTS, uint64_t retireTS, RetireType type) :
-        obj(obj), birthTS(birthTS), retireTS(retireTS), type(type) {}
+    retired_ptr obj; uint64_t birthTS;
+    RetiredObj(counted_ptr_t obj, uint64_t birthTS, RetireType type) :
+        obj(obj, type), birthTS(birthTS) {}
   };
+  static_assert(sizeof(RetiredObj) == 16);
 
   template<typename U>
   using acquired_pointer = basic_acquired_pointer<U>;
 
 
-  explicit acquire_retire_ibr(size_t num_threads_) :
-      base(num_threads_),
-      num_threads(num_threads_),
-      announcement_slots(num_threads),
-      in_progress(num_threads),
-      deferred_destructs(num_threads),
-      eject_work(num_threads),
-      epoch_work(num_threads) {}
+  acquire_retire_ibr() = default;
 
   template<typename U>
   [[nodiscard]] acquired_pointer<U> acquire(const std::atomic<U> *p) {
@@ -161,21 +188,35 @@ struct acquire_retire_ibr : public memory_manager_base<T, acquire_retire_ibr<T,
 
   void retire(counted_ptr_t p, RetireType type) {
     auto id = utils::threadID.getTID();
-    deferred_destructs[id].push_back(RetiredObj(p, get_birth_timestamp(p), epoch_tracker::instance().get_current_epoch(), type));
-    work_toward_ejects(1);
+    arm_thread_exit_hook();
+    deferred_destructs[id].push_back(RetiredObj(p, get_birth_timestamp(p), type), epoch_tracker::instance().get_current_epoch());
+    work_toward_ejects(id);
+  }
+
+  // Called by the exit hook of a thread that has retired objects. Applies the ejects that
+  // it has queued, and hands the rest of its deferred actions off to the remaining threads,
+  // which adopt them in their next pass.
+  void thread_exit() {
+    auto id = utils::threadID.getTID();
+    flush_queued_ejects();
+    hand_off_deferred(id);
   }
 
   // Perform any remaining deferred destruction. Need to be very careful
   // about additional objects being queued for deferred destruction by
   // an object that was just destructed.
   ~acquire_retire_ibr() {
-    in_progress.assign(in_progress.size(), true);
+    auto nt = utils::num_thread_ids();
+    for (size_t i = 0; i < nt; i++) in_progress[i] = true;
 
     // Loop because the destruction of one object could trigger the deferred
     // destruction of another object (possibly even in another thread), and
-    // so on recursively.
-    while (std::any_of(deferred_destructs.begin(), deferred_destructs.end(),
-                       [](const auto &v) { return !v.empty(); })) {
+    // so on recursively. The immortal objects are only released once nothing
+    // deferred can still refer to them.
+    while (any_deferred_destructs() || release_immortals()) {
+
+      // The actions handed off by exempt and exited threads are collected along with the rest
+      deferred_destructs[utils::threadID.getTID()].adopt(handed_off);
 
       // Move all of the contents from the deferred destruction lists
       // into a single local list. We don't want to just iterate the
@@ -183,12 +224,14 @@ struct acquire_retire_ibr : public memory_manager_base<T, acquire_retire_ibr<T,
       // deferred destruction to be added to one of the lists, which
       // would invalidate its iterators
       std::vector<std::pair<counted_ptr_t,RetireType>> destructs;
-      for (auto &v : deferred_destructs) {
+      for (size_t i = 0; i < nt; i++) {
+        auto &v = deferred_destructs[i];
         for (const auto& x : v) {
-            destructs.emplace_back(x.obj, x.type);
+            destructs.push_back(x.obj.unpack());
         }
         v.clear();
       }
+      take_queued_ejects(destructs);
 
       // Perform all of the pending deferred ejects
       for (auto [x,type] : destructs) {
@@ -200,60 +243,103 @@ struct acquire_retire_ibr : public memory_manager_base<T, acquire_retire_ibr<T,
 
  private:
 
+  bool any_deferred_destructs() {
+    auto nt = utils::num_thread_ids();
+    for (size_t i = 0; i < nt; i++) {
+      if (!deferred_destructs[i].empty()) return true;
+    }
+    return !handed_off.empty() || any_queued_ejects();
+  }
+
   void work_toward_advancing_epoch(size_t work = 1) {
     auto id = utils::threadID.getTID();
     epoch_work[id] = epoch_work[id] + work;
-    if(epoch_work[id] >= epoch_frequency * num_threads) {
+    if(epoch_work[id] >= epoch_frequency * utils::num_thread_ids()) {
         epoch_work[id] = 0;
         epoch_tracker::instance().advance_global_epoch();
+        record_epoch_advance(id);
     }
   }
 
-  void work_toward_ejects(size_t work = 1) {
-    auto id = utils::threadID.getTID();
-    eject_work[id] = eject_work[id] + work;
-    auto threshold = std::max<size_t>(30, eject_delay * eject_work.size());  // Always attempt at least 30 ejects
-    while (!in_progress[id] && eject_work[id] >= threshold) {
-      eject_work[id] = 0;
-      if (deferred_destructs[id].size() == 0) break; // nothing to collect
-      in_progress[id] = true;
-      auto deferred = AlignedVector<RetiredObj>(std::move(deferred_destructs[id]));
-
-      std::vector<std::pair<uint64_t, uint64_t>> announced;
-      epoch_tracker::instance().scan_announced_epochs([&](auto index, auto startTS) { 
-        uint64_t endTS = announcement_slots[index].endTS_ann.load();
-        if(startTS <= endTS) announced.push_back(std::make_pair(startTS, endTS)); 
-      });
-
-      auto f = [&, this](auto x) {
-        bool reserved = false;
-        for(auto& ann : announced) {
-          if(x.retireTS < ann.first || x.birthTS > ann.second) continue;
-          reserved = true;
-          break;
-        }
+  // Collect the announced intervals into the thread-local buffer, sorted
+  // by their start and with overlapping intervals merged together
+  AlignedVector<std::pair<uint64_t, uint64_t>>& collect_announced_intervals(size_t id) {
+    auto& announced = announced_intervals[id];
+    announced.clear();
+    epoch_tracker::instance().scan_announced_epochs([&](auto index, auto startTS) {
+      uint64_t endTS = announcement_slots[index].endTS_ann.load();
+      if(startTS <= endTS) announced.push_back(std::make_pair(startTS, endTS));
+    });
+    std::sort(announced.begin(), announced.end());
+    size_t merged = 0;
+    for (size_t i = 0; i < announced.size(); i++) {
+      if (merged > 0 && announced[i].first <= announced[merged-1].second) {
+        announced[merged-1].second = std::max(announced[merged-1].second, announced[i].second);
+      } else {
+        announced[merged++] = announced[i];
+      }
+    }
+    announced.resize(merged);
+    return announced;
+  }
 
-        if (!reserved) {
-          eject(x.obj, x.type);
-          return true;
-        } else {
-          return false;
-        }
-      };
+  // Advance the epoch right away for a pass forced by the limits on deferred actions, so that
+  // threads stop announcing the epoch in which the latest actions were retired
+  void advance_epoch(size_t id) {
+    epoch_work[id] = 0;
+    epoch_tracker::instance().advance_global_epoch();
+    record_epoch_advance(id);
+  }
 
-      // Remove the deferred decrements that are successfully applied
-      deferred.erase(remove_if(deferred.begin(), deferred.end(), f), deferred.end());
-      deferred_destructs[id].insert(deferred_destructs[id].end(), deferred.begin(), deferred.end());
-      in_progress[id] = false;
+  // Apply the deferred actions of the given thread that are no longer protected,
+  // after adopting any that exempt or exited threads have handed off, and return how many
+  // were applied. If the ejects of the type are bounded, examine at most limit of them,
+  // resuming the sweep in progress, which judges them by the announced intervals that were
+  // collected when it started, and queue those that are safe instead.
+  size_t eject_deferred(size_t id, size_t limit = unlimited_sweep) {
+    auto& list = deferred_destructs[id];
+    bool resume = resume_sweep(list, limit);
+    if (!resume) {
+      skip_retires(id, list.adopt(handed_off));
+      if (list.size() == 0) return 0; // nothing to collect
+    }
+    in_progress[id] = true;
+    auto pass = begin_pass(id, list.size());
+    auto& announced = resume ? announced_intervals[id] : collect_announced_intervals(id);
+
+    // The merged intervals are disjoint and sorted, so the only one that can
+    // overlap [birthTS, retireTS] is the first one that ends at or after birthTS.
+    // The stamp of an entry is its retire epoch, or a later epoch if a previous
+    // pass moved it, which can only make it look protected for longer
+    auto is_protected = [&announced](const auto& x, uint64_t retireTS) {
+      auto it = std::lower_bound(announced.begin(), announced.end(), x.birthTS,
+                                 [](const auto& ann, uint64_t t) { return ann.second < t; });
+      return it != announced.end() && it->first <= retireTS;
+    };
+
+    // Apply the deferred decrements that are no longer protected, coalescing
+    // duplicates of the same object, and keep the remaining ones for later
+    auto key = [](const auto& x) { return x.obj.unpack(); };
+    size_t ejected;
+    if constexpr (bounded_ejects) {
+      ejected = list.sweep_some(limit, is_protected, [this, key](const auto& x) { queue_eject(x, key); });
+    }
+    else {
+      ejected = list.sweep_with_stamps(is_protected, [this, key](auto first, auto last) { eject_ready(first, last, key); });
     }
+    end_pass(pass, ejected);
+    in_progress[id] = false;
+    return ejected;
   }
 
-  size_t num_threads;
-  std::vector<LocalSlot> announcement_slots;                      // Announcement array slots
-  std::vector<AlignedBool> in_progress;                           // Local flags to prevent reentrancy while destructing
-  std::vector<AlignedVector<RetiredObj>> deferred_destructs;      // Thread-local lists of pending deferred destructs
-  std::vector<AlignedInt> eject_work;                             // Amortized work to pay for ejecting deferred destructs
-  std::vector<AlignedInt> epoch_work;                             // Amortized work to pay for incrementing the epoch
+  utils::PerThreadArray<LocalSlot> announcement_slots;                      // Announcement array slots
+  utils::PerThreadArray<AlignedBool> in_progress;                           // Local flags to prevent reentrancy while destructing
+  utils::PerThreadArray<retire_list<RetiredObj>> deferred_destructs;       // Thread-local lists of pending deferred destructs
+  typename retire_list<RetiredObj>::handoff handed_off;                    // Deferred actions handed off by exempt and exited threads
+  utils::PerThreadArray<AlignedVector<std::pair<uint64_t, uint64_t>>> announced_intervals;  // Thread-local buffers of announced intervals, reused by every eject
+  utils::PerThreadArray<AlignedInt> eject_work;                             // Amortized work to pay for ejecting deferred destructs
+  utils::PerThreadArray<AlignedInt> epoch_work;                             // Amortized work to pay for incrementing the epoch
+  allocator_type allocator;                                                 // Allocates and frees the managed objects
 };
 
 
@@ -0,0 +1,293 @@
+
+#ifndef CDRC_SMR_ACQUIRE_RETIRE_QSBR_H
+#define CDRC_SMR_ACQUIRE_RETIRE_QSBR_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "../counted_object.h"
+#include "../memory_manager_base.h"
+#include "../retire_list.h"
+#include "../qsbr_tracker.h"
+#include "../slab_allocator.h"
+#include "../utils.h"
+
+namespace cdrc {
+
+namespace internal {
+
+// An interface for safe memory reclamation that protects reference-counted
+// resources by deferring their reference count decrements until no thread
+// is still reading them.
+//
+// This implementation uses quiescent-state-based reclamation, in which reads
+// and writes require no guard at all. Instead, every thread that uses the
+// shared pointers is responsible for periodically announcing a quiescent
+// state, i.e., a point at which it holds no snapshots, like so
+//
+//   while (running) {
+//     // critical code
+//     cdrc::quiescent_state();
+//   }
+//
+// A thread that is about to stop using the shared pointers for a long time
+// (e.g., before blocking) should go offline by calling cdrc::qsbr_offline(),
+// since a thread that is online but never announces a quiescent state will
+// prevent all memory from being reclaimed.
+//
+// T =               The underlying type of the object being protected
+// epoch_frequency = How often to update the global epoch. More often (lower value)
+//                   will reduce performance but decrease memory usage.
+// eject_delay =     The maximum number of deferred ejects that will be held by
+//                   any one worker thread is at most eject_delay * #threads.
+// Allocator =       The policy used to allocate the managed objects, either
+//                   new_delete_allocator or slab_allocator.
+//
+template<typename T, size_t epoch_frequency = 10, size_t eject_delay = 2, template<typename> typename Allocator = new_delete_allocator>
+struct acquire_retire_qsbr : public memory_manager_base<T, acquire_retire_qsbr<T, epoch_frequency, eject_delay, Allocator>> {
+
+  using base = memory_manager_base<T, acquire_retire_qsbr<T, epoch_frequency, eject_delay, Allocator>>;
+
+  using base::increment_allocations;
+  using base::decrement_allocations;
+  using base::increment_ref_cnt;
+  using base::eject;
+  using base::eject_ready;
+  using base::queue_eject;
+  using base::resume_sweep;
+  using base::bounded_ejects;
+  using base::unlimited_sweep;
+  using base::apply_queued_ejects;
+  using base::any_queued_ejects;
+  using base::release_immortals;
+  using base::take_queued_ejects;
+  using base::flush_queued_ejects;
+  using base::arm_thread_exit_hook;
+  using base::work_toward_ejects;
+  using base::hand_off_deferred;
+  using base::skip_retires;
+  using base::begin_pass;
+  using base::end_pass;
+  using base::record_epoch_advance;
+  using base::decrement_weak_cnt;
+
+private:
+  using counted_object_t = counted_object<T>;
+  using counted_ptr_t = std::add_pointer_t<counted_object_t>;
+  using retired_ptr = typename base::retired_ptr;
+
+  // The base class schedules the passes over deferred_destructs with eject_work, and
+  // makes them with advance_epoch and eject_deferred
+  friend base;
+  constexpr static size_t eject_delay_per_thread = eject_delay;
+
+  // A thread stalled between quiescent states holds back every deferred action retired since,
+  // so no number of passes could keep the pending actions under a hard limit
+  static_assert(base::hard_deferred_limit == 0,
+    "QSBR can not honor a hard limit on deferred actions; use a backend that keeps freeing what a stalled thread does not protect, such as IBR, HE or hazard pointers");
+
+public:
+
+  static acquire_retire_qsbr& instance() {
+    static acquire_retire_qsbr ar;
+    return ar;
+  }
+
+  // The allocator policy used for the managed objects
+  using allocator_type = Allocator<counted_object_t>;
+
+  template<typename... Args>
+  counted_ptr_t create_object(Args &&... args) {
+    increment_allocations();
+    work_toward_advancing_epoch(1);
+    return allocator.create(std::forward<Args>(args)...);
+  }
+
+  void delete_object(counted_ptr_t p) {
+    allocator.destroy(p);
+    decrement_allocations();
+  }
+
+  template<typename U>
+  using acquired_pointer = basic_acquired_pointer<U>;
+
+  acquire_retire_qsbr() {
+    qsbr_tracker::instance();  // touch the tracker to force it to initialize before this object,
+                               // so that it is destroyed after this object
+  }
+
+  template<typename U>
+  [[nodiscard]] acquired_pointer<U> acquire(const std::atomic<U> *p) {
+    qsbr_tracker::instance().ensure_online();
+    return {p->load(std::memory_order_acquire)};
+  }
+
+  // Like acquire, but assuming that the caller already has a
+  // copy of the handle and knows that it is protected
+  template<typename U>
+  [[nodiscard]] acquired_pointer<U> reserve(U p) {
+    return {p};
+  }
+
+  // Dummy function for when we need to conditionally reserve
+  // something, but might need to reserve nothing
+  template<typename U>
+  [[nodiscard]] acquired_pointer<U> reserve_nothing() const {
+    return {};
+  }
+
+  template<typename U>
+  [[nodiscard]] acquired_pointer<U> protect_snapshot(const std::atomic<U> *p) {
+    qsbr_tracker::instance().ensure_online();
+    auto ptr = p->load(std::memory_order_acquire);
+    if (ptr != nullptr && ptr->get_use_count() == 0) ptr = nullptr;
+    return {ptr};
+  }
+
+  void release() { }
+
+  void retire(counted_ptr_t p, RetireType type) {
+    auto id = utils::threadID.getTID();
+    arm_thread_exit_hook();
+    deferred_destructs[id].push_back(retired_ptr(p, type), qsbr_tracker::instance().get_current_epoch());
+    work_toward_ejects(id);
+  }
+
+  // Called by the exit hook of a thread that has retired objects. Applies the ejects that
+  // it has queued, and hands the rest of its deferred actions off to the remaining threads,
+  // which adopt them in their next pass.
+  void thread_exit() {
+    auto id = utils::threadID.getTID();
+    flush_queued_ejects();
+    hand_off_deferred(id);
+  }
+
+  // Called before each pass of drain. Advances the epoch and, if the current thread is online,
+  // announces a quiescent state for it, since drain is only called where it holds no references.
+  void prepare_drain_pass(size_t id) {
+    advance_epoch(id);
+    auto& tracker = qsbr_tracker::instance();
+    if (tracker.is_online()) tracker.quiescent_state();
+  }
+
+  // Perform any remaining deferred destruction. Need to be very careful
+  // about additional objects being queued for deferred destruction by
+  // an object that was just destructed.
+  ~acquire_retire_qsbr() {
+    auto nt = utils::num_thread_ids();
+    for (size_t i = 0; i < nt; i++) in_progress[i] = true;
+
+    // Loop because the destruction of one object could trigger the deferred
+    // destruction of another object (possibly even in another thread), and
+    // so on recursively. The immortal objects are only released once nothing
+    // deferred can still refer to them.
+    while (any_deferred_destructs() || release_immortals()) {
+
+      // The actions handed off by exempt and exited threads are collected along with the rest
+      deferred_destructs[utils::threadID.getTID()].adopt(handed_off);
+
+      // Move all of the contents from the deferred destruction lists
+      // into a single local list. We don't want to just iterate the
+      // deferred lists because a destruction may trigger another
+      // deferred destruction to be added to one of the lists, which
+      // would invalidate its iterators
+      std::vector<std::pair<counted_ptr_t,RetireType>> destructs;
+      for (size_t i = 0; i < nt; i++) {
+        auto &v = deferred_destructs[i];
+        for (const auto& x : v) {
+          destructs.push_back(x.unpack());
+        }
+        v.clear();
+      }
+      take_queued_ejects(destructs);
+
+      // Perform all of the pending deferred ejects
+      for (auto [x,type] : destructs) {
+        eject(x,type);
+      }
+    }
+  }
+
+private:
+
+  bool any_deferred_destructs() {
+    auto nt = utils::num_thread_ids();
+    for (size_t i = 0; i < nt; i++) {
+      if (!deferred_destructs[i].empty()) return true;
+    }
+    return !handed_off.empty() || any_queued_ejects();
+  }
+
+  void work_toward_advancing_epoch(size_t work = 1) {
+    auto id = utils::threadID.getTID();
+    epoch_work[id] = epoch_work[id] + work;
+    if(epoch_work[id] >= epoch_frequency * utils::num_thread_ids()) {
+      epoch_work[id] = 0;
+      qsbr_tracker::instance().advance_global_epoch();
+      record_epoch_advance(id);
+    }
+  }
+
+  // Advance the epoch right away, for the passes that the limits on deferred actions and
+  // drain force. The actions retired before it are applied once every online thread has
+  // announced a quiescent state since.
+  void advance_epoch(size_t id) {
+    qsbr_tracker::instance().advance_global_epoch();
+    record_epoch_advance(id);
+  }
+
+  // Apply the deferred actions of the given thread that are no longer protected,
+  // after adopting any that exempt or exited threads have handed off, and return how many
+  // were applied. If the ejects of the type are bounded, examine at most limit of them,
+  // resuming the sweep in progress, and queue those that are safe instead.
+  size_t eject_deferred(size_t id, size_t limit = unlimited_sweep) {
+    auto& list = deferred_destructs[id];
+    bool resume = resume_sweep(list, limit);
+    if (!resume) {
+      skip_retires(id, list.adopt(handed_off));
+      if (list.size() == 0) return 0; // nothing to collect
+    }
+    in_progress[id] = true;
+    auto pass = begin_pass(id, list.size());
+    auto min_epoch = qsbr_tracker::instance().get_min_announced_epoch();
+
+    // Apply the deferred decrements that were retired before the oldest announced
+    // epoch, coalescing duplicates of the same object, and keep the remaining ones
+    // for later. The list is stamped with the retire epochs, so the entries that
+    // are safe to eject are found a whole chunk at a time, except by a resumable sweep.
+    // The oldest announced epoch only grows, so the sweep reads it afresh each time.
+    auto key = [](const auto& x) { return x.unpack(); };
+    size_t ejected;
+    if constexpr (bounded_ejects) {
+      ejected = list.sweep_some(limit, [min_epoch](const auto&, uint64_t epoch) { return epoch >= min_epoch; },
+                                [this, key](const auto& x) { queue_eject(x, key); });
+    }
+    else {
+      ejected = list.sweep_stamped_before(min_epoch, [this, key](auto first, auto last) { eject_ready(first, last, key); });
+    }
+    end_pass(pass, ejected);
+    in_progress[id] = false;
+    return ejected;
+  }
+
+  utils::PerThreadArray<AlignedBool> in_progress;                         // Local flags to prevent reentrancy while destructing
+  utils::PerThreadArray<retire_list<retired_ptr>> deferred_destructs;    // Thread-local lists of pending deferred destructs
+  typename retire_list<retired_ptr>::handoff handed_off;                 // Deferred actions handed off by exempt and exited threads
+  utils::PerThreadArray<AlignedInt> eject_work;                           // Amortized work to pay for ejecting deferred destructs
+  utils::PerThreadArray<AlignedInt> epoch_work;                           // Amortized work to pay for incrementing the epoch
+  allocator_type allocator;                                               // Allocates and frees the managed objects
+};
+
+
+}  // namespace internal
+
+}  // namespace cdrc
+
+#endif // CDRC_SMR_ACQUIRE_RETIRE_QSBR_H
@@ -1,11 +1,15 @@
 #ifndef CDRC_INTERNAL_UTILS_H
 #define CDRC_INTERNAL_UTILS_H
 
+#include <cassert>
 #include <cstdint>
 #include <cstdlib>
 
+#include <algorithm>
 #include <atomic>
+#include <bit>
 #include <iostream>
+#include <limits>
 #include <memory>
 #include <string>
 #include <thread>
@@ -13,6 +17,13 @@
 #include <utility>
 #include <vector>
 
+#if defined(__linux__) && __has_include(<linux/membarrier.h>)
+#include <linux/membarrier.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#define CDRC_HAS_MEMBARRIER 1
+#endif
+
 
 const int PADDING = 64;
 
@@ -71,6 +82,9 @@ struct alignas(128) AlignedBool {
 
 namespace utils {
 
+// The configured number of threads. This is only a sizing hint for the
+// per-thread data of the memory management backends, which grow beyond it
+// if more threads show up, but fixed-size external code may rely on it.
 size_t num_threads() {
   static size_t n_threads = []() -> size_t {
     if (const auto env_p = std::getenv("NUM_THREADS")) {
@@ -165,6 +179,13 @@ public:
     return (val & zero_flag<T>) ? 0 : val;
   }
 
+  // Loads the current value of the counter without its flags. Unlike load, this never
+  // writes to the counter, but a zero counter may read as a small nonzero value, left
+  // there by the increments that failed on it.
+  T peek(std::memory_order order = std::memory_order_seq_cst) const noexcept {
+    return x.load(order) & (zero_pending_flag<T> - 1);
+  }
+
   // Resets the value of the counter to the given value. This may be called when the counter
   // is zero to bring it back to a non-zero value.
   //
@@ -177,6 +198,13 @@ private:
   mutable std::atomic<T> x;
 };
 
+// The outcome of releasing strong references to an object
+enum class StrongRelease {
+  nonzero,              // The strong count is still positive
+  zero,                 // The strong count hit zero, but weak references remain
+  zero_and_no_weak      // The strong count hit zero and only the implicit weak reference remains
+};
+
 template<typename T>
 class StrongAndWeakCounter {
   alignas(alignof(T)) unsigned char storage[sizeof(T)];
@@ -188,6 +216,7 @@ public:
 
   T load_strong(std::memory_order order = std::memory_order_seq_cst) const { return ref_cnt.load(order); }
   T load_weak(std::memory_order order = std::memory_order_seq_cst) const { return weak_cnt.load(order); }
+  T peek_strong(std::memory_order order = std::memory_order_seq_cst) const { return ref_cnt.peek(order); }
 
   bool increment_strong(uint64_t count) {
     // any thread that moves the strong reference count from 0->1 to have to increment the weak reference count
@@ -211,39 +240,414 @@ public:
   }
   bool decrement_weak(uint64_t count) { return weak_cnt.decrement(count, std::memory_order_release); }
 
+  // Decrement the strong count, and if it hits zero, check whether any weak references remain
+  StrongRelease release_strong(uint64_t count) {
+    if (!decrement_strong(count)) return StrongRelease::nonzero;
+    return (load_weak(std::memory_order_relaxed) == 1) ? StrongRelease::zero_and_no_weak : StrongRelease::zero;
+  }
+
 private:
   StickyCounter<uint32_t> ref_cnt;
   StickyCounter<uint32_t> weak_cnt;
 };
 
+// A strong reference count for objects that never have weak references. Since only
+// a holder of a weak reference could attempt to increment a strong count from zero,
+// the count does not need to be sticky, and releasing the last strong reference
+// takes a single fetch_sub.
+class StrongCounter {
+public:
+  StrongCounter(uint32_t count) noexcept : x(count) {}
+  StrongCounter(const StrongCounter&) = delete;
+  StrongCounter(StrongCounter&&) = delete;
 
-struct ThreadID {
-  static std::vector<std::atomic<bool>> in_use; // initialize to false
-  int tid;
+  uint32_t load_strong(std::memory_order order = std::memory_order_seq_cst) const { return x.load(order); }
+  uint32_t peek_strong(std::memory_order order = std::memory_order_seq_cst) const { return x.load(order); }
+
+  // Only the weak reference held collectively by the strong references exists
+  uint32_t load_weak(std::memory_order = std::memory_order_seq_cst) const { return 1; }
+
+  bool increment_strong(uint64_t count) { return x.fetch_add(count, std::memory_order_relaxed) != 0; }
+
+  bool decrement_strong(uint64_t count) { return x.fetch_sub(count, std::memory_order_release) == count; }
+
+  StrongRelease release_strong(uint64_t count) {
+    return decrement_strong(count) ? StrongRelease::zero_and_no_weak : StrongRelease::nonzero;
+  }
+
+private:
+  std::atomic<uint32_t> x;
+};
+
+// A strong and a weak sticky counter packed into a single 64-bit word, with the
+// strong count in the low half and the weak count in the high half. Each half has
+// the same layout and semantics as a StickyCounter<uint32_t>.
+//
+// Since both counts are read by the same atomic update, dropping the last strong
+// reference of an object without weak references takes a single fetch_sub. The
+// strong count is then left at zero without its zero flag, which is safe because
+// only the holder of a weak reference could attempt to increment it again.
+class PackedStrongAndWeakCounter {
+  static constexpr uint64_t half_bits = 32;
+  static constexpr uint64_t half_mask = (uint64_t(1) << half_bits) - 1;
+  static constexpr uint64_t zero = zero_flag<uint32_t>;
+  static constexpr uint64_t zero_pending = zero_pending_flag<uint32_t>;
+
+public:
+  PackedStrongAndWeakCounter(uint32_t count) noexcept : x(pack(count, count)) {}
+  PackedStrongAndWeakCounter(const PackedStrongAndWeakCounter&) = delete;
+  PackedStrongAndWeakCounter(PackedStrongAndWeakCounter&&) = delete;
+
+  uint32_t load_strong(std::memory_order order = std::memory_order_seq_cst) const { return load(0, order); }
+  uint32_t load_weak(std::memory_order order = std::memory_order_seq_cst) const { return load(half_bits, order); }
+
+  // Loads the strong count without its flags, like StickyCounter::peek
+  uint32_t peek_strong(std::memory_order order = std::memory_order_seq_cst) const {
+    return half(x.load(order), 0) & (zero_pending - 1);
+  }
+
+  bool increment_strong(uint64_t count) { return increment(0, count); }
+  bool increment_weak(uint64_t count) { return increment(half_bits, count); }
+
+  bool decrement_strong(uint64_t count) { return release_strong(count) != StrongRelease::nonzero; }
+  bool decrement_weak(uint64_t count) {
+    uint64_t old = x.fetch_sub(count << half_bits, std::memory_order_release);
+    return half(old, half_bits) == count && make_sticky(half_bits, old - (count << half_bits));
+  }
+
+  // Decrement the strong count, and if it hits zero, check whether any weak references remain
+  StrongRelease release_strong(uint64_t count) { return finish_release_strong(count, begin_release_strong(count)); }
+
+protected:
+  // The two steps of release_strong, split so that tests can run other operations between
+  // the decrement and the check of its outcome. begin_release_strong returns the old value.
+  uint64_t begin_release_strong(uint64_t count) { return x.fetch_sub(count, std::memory_order_release); }
+
+  StrongRelease finish_release_strong(uint64_t count, uint64_t old) {
+    if (half(old, 0) != count) return StrongRelease::nonzero;
+    if (half(old, half_bits) == 1) [[likely]] return StrongRelease::zero_and_no_weak;
+    if (!make_sticky(0, old - count)) return StrongRelease::nonzero;
+    return (load_weak(std::memory_order_relaxed) == 1) ? StrongRelease::zero_and_no_weak : StrongRelease::zero;
+  }
+
+private:
+  static constexpr uint64_t pack(uint32_t strong, uint32_t weak) {
+    return (strong == 0 ? zero : strong) | (uint64_t(weak == 0 ? zero : weak) << half_bits);
+  }
+
+  static constexpr uint64_t half(uint64_t val, uint64_t shift) { return (val >> shift) & half_mask; }
+
+  bool increment(uint64_t shift, uint64_t count) {
+    uint64_t old = x.fetch_add(count << shift, std::memory_order_relaxed);
+    return (half(old, shift) & zero) == 0;
+  }
+
+  uint32_t load(uint64_t shift, std::memory_order order) const {
+    uint64_t val = x.load(order);
+    while (half(val, shift) == 0) {
+      if (x.compare_exchange_weak(val, val | ((zero | zero_pending) << shift))) [[likely]] return 0;
+    }
+    return (half(val, shift) & zero) ? 0 : half(val, shift);
+  }
+
+  // After a decrement brought the given half to zero, set its zero flag, unless
+  // it has been incremented again in the meantime. Like StickyCounter::decrement,
+  // a zero_pending flag left by a load that saw the zero is claimed instead, along
+  // with whatever the increments that failed on it since then added to the half.
+  bool make_sticky(uint64_t shift, uint64_t expected) {
+    while (true) {
+      uint64_t h = half(expected, shift);
+      if (h != 0 && !(h & zero_pending)) return false;
+      uint64_t desired = (expected & ~(half_mask << shift)) | (zero << shift);
+      if (x.compare_exchange_weak(expected, desired)) return true;
+    }
+  }
+
+  mutable std::atomic<uint64_t> x;
+};
+
+// The outcome of releasing references to an object with a BiasedCounter
+enum class BiasedRelease {
+  nonzero,              // The object is still referenced and nothing else needs to be done
+  unowned,              // The owner merged the counts and gave the object up, which is still referenced
+  zero,                 // The count hit zero
+  queue                 // The shared count went negative, so the object must be queued to its owner
+};
+
+// A strong reference count for biased reference counting. Objects are owned by the
+// thread that created them, which counts its references in a biased count with plain
+// loads and stores, while other threads count theirs in a shared atomic count. The
+// true count is the sum of the two, so the shared count can be negative.
+//
+// The owner merges the biased count into the shared count when the biased count hits
+// zero, after which the object is unowned and only the shared count is used. When the
+// shared count of an owned object first goes negative, the object may have no references
+// left, so it is queued, and the owner (or, if it has exited, the thread that queued
+// it) merges it explicitly. While it is queued, the owner field links it into the queue.
+//
+// Like StrongCounter, it does not support weak references, since nothing can
+// increment the count of an object that has no references left.
+class BiasedCounter {
+  // The shared count is stored with an offset, so that it can go negative without
+  // borrowing from the flags
+  static constexpr uint32_t merged_flag = uint32_t(1) << 31;
+  static constexpr uint32_t queued_flag = uint32_t(1) << 30;
+  static constexpr uint32_t offset = uint32_t(1) << 29;
+  static constexpr uint32_t count_mask = queued_flag - 1;
+
+public:
+  // A new counter is unowned, i.e., it starts out merged
+  BiasedCounter(uint32_t count) noexcept : owner(nullptr), biased(0), shared(merged_flag | (offset + count)) {}
+  BiasedCounter(const BiasedCounter&) = delete;
+  BiasedCounter(BiasedCounter&&) = delete;
+
+  // Make the given owner the owner of a new counter whose count is one
+  void adopt(const void* owner_) {
+    assert(shared.load(std::memory_order_relaxed) == (merged_flag | (offset + 1)));
+    owner.store(owner_, std::memory_order_relaxed);
+    biased.store(1, std::memory_order_relaxed);
+    shared.store(offset, std::memory_order_relaxed);
+  }
+
+  bool is_owned_by(const void* me) const { return owner.load(std::memory_order_relaxed) == me; }
+
+  // The owner of an owned counter, or the next counter in the queue of a queued counter
+  const void* get_owner() const { return owner.load(std::memory_order_relaxed); }
+  void set_next(const void* next) { owner.store(next, std::memory_order_relaxed); }
+
+  // An approximate count for a thread that is not the owner, which is exact once
+  // the object is unowned. An owned object always appears to be referenced.
+  uint32_t load_strong(std::memory_order order = std::memory_order_seq_cst) const {
+    uint32_t val = shared.load(order);
+    if (val & merged_flag) return count_of(val);
+    return static_cast<uint32_t>(std::max<int64_t>(1, biased.load(std::memory_order_relaxed) + count_of(val)));
+  }
+
+  uint32_t load_weak(std::memory_order = std::memory_order_seq_cst) const { return 1; }
+
+  // Only to be called by the owner
+  void increment_owned(uint64_t count) { biased.store(biased.load(std::memory_order_relaxed) + count, std::memory_order_relaxed); }
+
+  void increment_shared(uint64_t count) { shared.fetch_add(count, std::memory_order_relaxed); }
 
-  ThreadID() {
-    for(size_t i = 0; i < num_threads(); i++) {
-      bool expected = false;
-      if(!in_use[i] && in_use[i].compare_exchange_strong(expected, true)) {
-        tid = i;
-        return;
+  // Only to be called by the owner. Returns nonzero, or if the biased count hits
+  // zero, either unowned or zero after giving the object up
+  BiasedRelease decrement_owned(uint64_t count) {
+    uint64_t b = biased.load(std::memory_order_relaxed);
+    if (count < b) {
+      biased.store(b - count, std::memory_order_relaxed);
+      return BiasedRelease::nonzero;
+    }
+    uint64_t rest = count - b;
+    biased.store(0, std::memory_order_relaxed);
+    uint32_t old = shared.load(std::memory_order_relaxed), desired;
+    do {
+      // If the object is queued, leave the merge to whoever processes the queue
+      desired = (old & queued_flag) ? old - rest : (old - rest) | merged_flag;
+    } while (!shared.compare_exchange_weak(old, desired, std::memory_order_acq_rel, std::memory_order_relaxed));
+    if (desired & queued_flag) return BiasedRelease::nonzero;
+    owner.store(nullptr, std::memory_order_relaxed);
+    return count_of(desired) == 0 ? BiasedRelease::zero : BiasedRelease::unowned;
+  }
+
+  // Returns zero if the count of an unowned object hit zero, and queue if the object
+  // is owned and its shared count became negative for the first time
+  BiasedRelease decrement_shared(uint64_t count) {
+    uint32_t old = shared.load(std::memory_order_relaxed), desired;
+    do {
+      desired = old - count;
+      if (!(old & (merged_flag | queued_flag)) && count_of(desired) < 0) desired |= queued_flag;
+    } while (!shared.compare_exchange_weak(old, desired, std::memory_order_acq_rel, std::memory_order_relaxed));
+    if (desired & merged_flag) return count_of(desired) == 0 ? BiasedRelease::zero : BiasedRelease::nonzero;
+    return ((desired ^ old) & queued_flag) ? BiasedRelease::queue : BiasedRelease::nonzero;
+  }
+
+  // Merge the biased count of a queued object into its shared count. Must be called
+  // by its owner, or by another thread once the owner has exited.
+  BiasedRelease merge() {
+    owner.store(nullptr, std::memory_order_relaxed);
+    uint64_t b = biased.load(std::memory_order_relaxed);
+    biased.store(0, std::memory_order_relaxed);
+    uint32_t old = shared.load(std::memory_order_relaxed), desired;
+    do {
+      desired = merged_flag | ((old & count_mask) + b);
+    } while (!shared.compare_exchange_weak(old, desired, std::memory_order_acq_rel, std::memory_order_relaxed));
+    return count_of(desired) == 0 ? BiasedRelease::zero : BiasedRelease::unowned;
+  }
+
+private:
+  static int64_t count_of(uint32_t val) { return int64_t(val & count_mask) - offset; }
+
+  // The biased count is only ever updated by the owner, so it is only atomic so that
+  // other threads can read it, and it is updated with plain loads and stores
+  std::atomic<const void*> owner;
+  std::atomic<uint32_t> biased;
+  std::atomic<uint32_t> shared;
+};
+
+// Hands out small integer IDs to threads. IDs that are returned by exiting
+// threads are kept on a lock-free free-list and handed out again before any
+// new ID is created, so the IDs in use are always below the maximum number of
+// threads that have been alive at once, rather than some configured limit.
+class ThreadIDRegistry {
+  static constexpr uint32_t nil = std::numeric_limits<uint32_t>::max();
+
+ public:
+  static ThreadIDRegistry& instance() {
+    static ThreadIDRegistry registry;
+    return registry;
+  }
+
+  int acquire() {
+    // The top half of the free-list head is a tag that is bumped on every
+    // update to prevent ABA when an ID is popped and pushed back concurrently
+    uint64_t head = free_head.load(std::memory_order_acquire);
+    while (index_of(head) != nil) {
+      uint32_t next = free_next(index_of(head)).load(std::memory_order_relaxed);
+      if (free_head.compare_exchange_weak(head, pack(next, tag_of(head) + 1))) {
+        return static_cast<int>(index_of(head));
       }
     }
-    std::cerr << "Error: more than " << num_threads() << " threads created" << std::endl;
-    std::exit(1);
+    return static_cast<int>(next_id.fetch_add(1));
+  }
+
+  void release(int id) {
+    uint64_t head = free_head.load(std::memory_order_relaxed);
+    do {
+      free_next(id).store(index_of(head), std::memory_order_relaxed);
+    } while (!free_head.compare_exchange_weak(head, pack(id, tag_of(head) + 1)));
+  }
+
+  // The number of IDs handed out so far. Every registered thread
+  // has an ID that is less than this.
+  size_t size() const { return next_id.load(); }
+
+ private:
+  ThreadIDRegistry() : free_head(pack(nil, 0)), next_id(0) {}
+
+  static uint64_t pack(uint32_t index, uint32_t tag) { return (static_cast<uint64_t>(tag) << 32) | index; }
+  static uint32_t index_of(uint64_t head) { return static_cast<uint32_t>(head); }
+  static uint32_t tag_of(uint64_t head) { return static_cast<uint32_t>(head >> 32); }
+
+  std::atomic<uint32_t>& free_next(size_t id);
+
+  std::atomic<uint64_t> free_head;
+  std::atomic<uint32_t> next_id;
+};
+
+// The number of thread IDs that have been handed out so far, i.e., an upper
+// bound on the ID of any registered thread. Scans over per-thread data only
+// need to visit this many slots.
+inline size_t num_thread_ids() {
+  return ThreadIDRegistry::instance().size();
+}
+
+// An array with one element per thread ID that grows in place as threads
+// register. Elements live in segments of doubling size that are allocated on
+// first use and never moved, so references to existing elements stay valid
+// while other threads grow the array. The first segment is large enough for
+// the configured number of threads, so the common case has a single segment.
+template<typename T>
+class PerThreadArray {
+  static constexpr size_t max_segments = 32;
+
+ public:
+  PerThreadArray() : base(num_threads()) {
+    for (auto& segment : segments) std::atomic_init(&segment, nullptr);
+  }
+
+  PerThreadArray(const PerThreadArray&) = delete;
+  PerThreadArray& operator=(const PerThreadArray&) = delete;
+
+  ~PerThreadArray() {
+    for (auto& segment : segments) delete[] segment.load();
   }
 
+  T& operator[](size_t i) {
+    size_t s = 0, offset = i;
+    if (i >= base) [[unlikely]] {
+      s = std::bit_width(i / base + 1) - 1;
+      offset = i - base * ((size_t{1} << s) - 1);
+    }
+    T* segment = segments[s].load(std::memory_order_acquire);
+    if (segment == nullptr) [[unlikely]] segment = allocate_segment(s);
+    return segment[offset];
+  }
+
+  // The number of elements that correspond to handed-out thread IDs
+  size_t size() const { return num_thread_ids(); }
+
+ private:
+  T* allocate_segment(size_t s) {
+    assert(s < max_segments);
+    T* segment = new T[base << s]();
+    T* expected = nullptr;
+    if (!segments[s].compare_exchange_strong(expected, segment)) {
+      delete[] segment;
+      return expected;
+    }
+    return segment;
+  }
+
+  const size_t base;
+  std::atomic<T*> segments[max_segments];
+};
+
+inline std::atomic<uint32_t>& ThreadIDRegistry::free_next(size_t id) {
+  static PerThreadArray<std::atomic<uint32_t>> next;
+  return next[id];
+}
+
+struct ThreadID {
+  int tid;
+
+  ThreadID() : tid(ThreadIDRegistry::instance().acquire()) { }
+
   ~ThreadID() {
-    in_use[tid] = false;
+    ThreadIDRegistry::instance().release(tid);
   }
 
   int getTID() const { return tid; }
 };
 
-std::vector<std::atomic<bool>> ThreadID::in_use(num_threads());
-
 thread_local ThreadID threadID;
 
+// Asymmetric fences. light_fence only prevents compiler reordering, while
+// heavy_fence forces a full memory barrier on every running thread of the
+// process (Linux membarrier), so a light fence on one side paired with a
+// heavy fence on the other is as strong as a seq_cst fence on both.
+//
+// register_asymmetric_fences() must have returned true before the pair is
+// relied upon. It returns false if the kernel does not support expedited
+// private membarriers, in which case the caller must use ordinary fences.
+inline bool register_asymmetric_fences() {
+  static bool supported = []() -> bool {
+#ifdef CDRC_HAS_MEMBARRIER
+    long cmds = syscall(__NR_membarrier, MEMBARRIER_CMD_QUERY, 0);
+    if (cmds < 0 || !(cmds & MEMBARRIER_CMD_PRIVATE_EXPEDITED)) return false;
+    return syscall(__NR_membarrier, MEMBARRIER_CMD_REGISTER_PRIVATE_EXPEDITED, 0) == 0;
+#else
+    return false;
+#endif
+  }();
+  return supported;
+}
+
+inline void light_fence() {
+  std::atomic_signal_fence(std::memory_order_seq_cst);
+}
+
+inline void heavy_fence() {
+#ifdef CDRC_HAS_MEMBARRIER
+  if (register_asymmetric_fences()) {
+    [[maybe_unused]] auto res = syscall(__NR_membarrier, MEMBARRIER_CMD_PRIVATE_EXPEDITED, 0);
+    assert(res == 0);
+    return;
+  }
+#endif
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+}
+
 // a slightly cheaper, but possibly not as good version
 // based on splitmix64
 inline uint64_t hash64_2(uint64_t x) {
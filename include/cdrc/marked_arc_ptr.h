@@ -187,6 +187,111 @@ using marked_weak_ptr_hyaline = marked_weak_ptr<T, internal::acquire_retire_hyal
 template<typename T>
 using marked_ws_ptr_hyaline = marked_ws_ptr<T, internal::acquire_retire_hyaline<T>>;
 
+// Alias templates for marked pointers with hazard-pointer (asymmetric fence)
+
+template<typename T>
+using marked_arc_ptr_hp_membarrier = marked_arc_ptr<T, internal::acquire_retire_membarrier<T>>;
+
+template<typename T>
+using marked_rc_ptr_hp_membarrier = marked_rc_ptr<T, internal::acquire_retire_membarrier<T>>;
+
+template<typename T>
+using marked_snapshot_ptr_hp_membarrier = marked_snapshot_ptr<T, internal::acquire_retire_membarrier<T>>;
+
+template<typename T>
+using marked_aw_ptr_hp_membarrier = marked_aw_ptr<T, internal::acquire_retire_membarrier<T>>;
+
+template<typename T>
+using marked_weak_ptr_hp_membarrier = marked_weak_ptr<T, internal::acquire_retire_membarrier<T>>;
+
+template<typename T>
+using marked_ws_ptr_hp_membarrier = marked_ws_ptr<T, internal::acquire_retire_membarrier<T>>;
+
+
+// Alias templates for marked pointers with QSBR
+
+template<typename T>
+using marked_arc_ptr_qsbr = marked_arc_ptr<T, internal::acquire_retire_qsbr<T>>;
+
+template<typename T>
+using marked_rc_ptr_qsbr = marked_rc_ptr<T, internal::acquire_retire_qsbr<T>>;
+
+template<typename T>
+using marked_snapshot_ptr_qsbr = marked_snapshot_ptr<T, internal::acquire_retire_qsbr<T>>;
+
+template<typename T>
+using marked_aw_ptr_qsbr = marked_aw_ptr<T, internal::acquire_retire_qsbr<T>>;
+
+template<typename T>
+using marked_weak_ptr_qsbr = marked_weak_ptr<T, internal::acquire_retire_qsbr<T>>;
+
+template<typename T>
+using marked_ws_ptr_qsbr = marked_ws_ptr<T, internal::acquire_retire_qsbr<T>>;
+
+
+// Alias templates for marked pointers with hazard eras
+
+template<typename T>
+using marked_arc_ptr_he = marked_arc_ptr<T, internal::acquire_retire_he<T>>;
+
+template<typename T>
+using marked_rc_ptr_he = marked_rc_ptr<T, internal::acquire_retire_he<T>>;
+
+template<typename T>
+using marked_snapshot_ptr_he = marked_snapshot_ptr<T, internal::acquire_retire_he<T>>;
+
+template<typename T>
+using marked_aw_ptr_he = marked_aw_ptr<T, internal::acquire_retire_he<T>>;
+
+template<typename T>
+using marked_weak_ptr_he = marked_weak_ptr<T, internal::acquire_retire_he<T>>;
+
+template<typename T>
+using marked_ws_ptr_he = marked_ws_ptr<T, internal::acquire_retire_he<T>>;
+
+
+#if defined(__GCC_HAVE_SYNC_COMPARE_AND_SWAP_16)
+// Alias templates for marked pointers with wait-free eras
+
+template<typename T>
+using marked_arc_ptr_wfe = marked_arc_ptr<T, internal::acquire_retire_wfe<T>>;
+
+template<typename T>
+using marked_rc_ptr_wfe = marked_rc_ptr<T, internal::acquire_retire_wfe<T>>;
+
+template<typename T>
+using marked_snapshot_ptr_wfe = marked_snapshot_ptr<T, internal::acquire_retire_wfe<T>>;
+
+template<typename T>
+using marked_aw_ptr_wfe = marked_aw_ptr<T, internal::acquire_retire_wfe<T>>;
+
+template<typename T>
+using marked_weak_ptr_wfe = marked_weak_ptr<T, internal::acquire_retire_wfe<T>>;
+
+template<typename T>
+using marked_ws_ptr_wfe = marked_ws_ptr<T, internal::acquire_retire_wfe<T>>;
+#endif
+// Alias templates for marked pointers with robust Hyaline (Hyaline-S)
+
+template<typename T>
+using marked_arc_ptr_hyaline_s = marked_arc_ptr<T, internal::acquire_retire_hyaline_s<T>>;
+
+template<typename T>
+using marked_rc_ptr_hyaline_s = marked_rc_ptr<T, internal::acquire_retire_hyaline_s<T>>;
+
+template<typename T>
+using marked_snapshot_ptr_hyaline_s = marked_snapshot_ptr<T, internal::acquire_retire_hyaline_s<T>>;
+
+template<typename T>
+using marked_aw_ptr_hyaline_s = marked_aw_ptr<T, internal::acquire_retire_hyaline_s<T>>;
+
+template<typename T>
+using marked_weak_ptr_hyaline_s = marked_weak_ptr<T, internal::acquire_retire_hyaline_s<T>>;
+
+template<typename T>
+using marked_ws_ptr_hyaline_s = marked_ws_ptr<T, internal::acquire_retire_hyaline_s<T>>;
+
+
 
 namespace internal {
 
@@ -4,11 +4,13 @@
 
 #include <cstddef>
 
+#include <memory_resource>
 #include <type_traits>
 #include <utility>
 
 #include "internal/counted_object.h"
 #include "internal/fwd_decl.h"
+#include "internal/pmr_allocator.h"
 
 #include "weak_ptr.h"
 
@@ -106,10 +108,55 @@ class rc_ptr : public pointer_policy::template rc_ptr_policy<T> {
     std::swap(ptr, other.ptr);
   }
 
+  // Write n copies of this rc_ptr to out, taking all n references with
+  // a single update of the reference count. Returns the end of the output.
+  template<typename OutputIt>
+  OutputIt clone_n(size_t n, OutputIt out) const {
+    if (ptr && n > 0) mm.increment_ref_cnt(ptr, n);
+    for (size_t i = 0; i < n; i++) *out++ = rc_ptr(ptr, AddRef::no);
+    return out;
+  }
+
+  // Clear every rc_ptr in [first, last). Consecutive rc_ptrs to the same object,
+  // such as those produced by clone_n, release their references with a single
+  // update of its reference count.
+  template<typename ForwardIt>
+  static void release_all(ForwardIt first, ForwardIt last) {
+    while (first != last) {
+      counted_ptr_t p = first->release();
+      uint64_t count = 1;
+      for (++first; first != last && first->ptr == p; ++first, ++count) first->release();
+      if (p) mm.decrement_ref_cnt(p, count);
+    }
+  }
+
   // Create a new rc_ptr containing an object of type T constructed from (args...).
   template<typename... Args>
   static rc_ptr make_shared(Args &&... args) {
-    auto ptr = mm.create_object(std::forward<Args>(args)...);
+    auto ptr = mm.adopt_object(mm.create_object(std::forward<Args>(args)...));
+    return rc_ptr(ptr, AddRef::no);
+  }
+
+  // Create a new rc_ptr containing an immortal object of type T constructed from (args...).
+  // Copying and dropping references to an immortal object never update its reference count,
+  // so it is never destroyed while the program runs. It is destroyed when the program exits,
+  // before the memory manager is, so it must not be used by the destructors of other statics.
+  // Only types that specialize cdrc::immortal_objects to std::true_type can be immortal.
+  template<typename... Args>
+    requires counted_object_t::immortal
+  static rc_ptr make_immortal(Args &&... args) {
+    auto ptr = mm.make_immortal(mm.create_object(std::forward<Args>(args)...));
+    return rc_ptr(ptr, AddRef::no);
+  }
+
+  // Create a new rc_ptr containing an object of type T constructed from (args...), whose
+  // storage, including its reference counts, is allocated from the memory resource of alloc.
+  // The memory manager must allocate its objects with the pmr_allocator policy.
+  template<typename... Args>
+  static rc_ptr allocate_shared(std::pmr::polymorphic_allocator<std::byte> alloc, Args &&... args) {
+    static_assert(requires { memory_manager::allocator_type::uses_memory_resource; },
+      "allocate_shared requires a memory manager that uses the pmr_allocator policy");
+    auto ptr = mm.adopt_object(mm.create_object(internal::from_resource{alloc.resource()}, std::forward<Args>(args)...));
     return rc_ptr(ptr, AddRef::no);
   }
 
@@ -156,6 +203,29 @@ static rc_ptr<T, memory_manager, pointer_policy> make_rc(Args &&... args) {
   return rc_ptr<T, memory_manager, pointer_policy>::make_shared(std::forward<Args>(args)...);
 }
 
+// Create a new rc_ptr containing an immortal object of type T constructed from (args...).
+template<typename T, typename memory_manager = internal::default_memory_manager<T>,
+  typename pointer_policy = internal::default_pointer_policy, typename... Args>
+static rc_ptr<T, memory_manager, pointer_policy> make_immortal(Args &&... args) {
+  return rc_ptr<T, memory_manager, pointer_policy>::make_immortal(std::forward<Args>(args)...);
+}
+
+// Create a new rc_ptr containing an object of type T constructed from (args...),
+// allocated from the memory resource of alloc.
+template<typename T, typename memory_manager = hp_pmr_backend<T>,
+  typename pointer_policy = internal::default_pointer_policy, typename... Args>
+static rc_ptr<T, memory_manager, pointer_policy> allocate_shared(std::pmr::polymorphic_allocator<std::byte> alloc, Args &&... args) {
+  return rc_ptr<T, memory_manager, pointer_policy>::allocate_shared(alloc, std::forward<Args>(args)...);
+}
+
+// Create a new rc_ptr containing an object of type T constructed from (args...),
+// allocated from the memory resource of alloc.
+template<typename T, typename memory_manager = hp_pmr_backend<T>,
+  typename pointer_policy = internal::default_pointer_policy, typename... Args>
+static rc_ptr<T, memory_manager, pointer_policy> allocate_rc(std::pmr::polymorphic_allocator<std::byte> alloc, Args &&... args) {
+  return rc_ptr<T, memory_manager, pointer_policy>::allocate_shared(alloc, std::forward<Args>(args)...);
+}
+
 }  // namespace cdrc
 
 #endif  // CDRC_RC_PTR_H_
@@ -0,0 +1,26 @@
+#ifndef CDRC_STATS_H
+#define CDRC_STATS_H
+
+#include "internal/fwd_decl.h"
+#include "internal/memory_manager_base.h"
+#include "internal/reclamation_stats.h"
+
+namespace cdrc {
+
+// A snapshot of the statistics of the given memory manager, such as cdrc::ebr_backend<T>,
+// summed over its threads. The memory managers only collect them if CDRC_STATS is defined
+// in every translation unit, since otherwise the code that collects them compiles to nothing,
+// except for the hits of the deferred limits, which are always counted. The counters of
+// different threads are read one after another, so the snapshot is not atomic.
+//
+//   auto s = cdrc::stats<cdrc::ebr_backend<Node>>();
+//   std::cout << s.ejects << " ejects in " << s.eject_passes << " passes\n";
+//
+template<typename MemoryManager>
+reclamation_stats stats() {
+  return MemoryManager::instance().stats();
+}
+
+}  // namespace cdrc
+
+#endif  // CDRC_STATS_H
@@ -0,0 +1,1073 @@
+#include "gtest/gtest.h"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <memory_resource>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include <cdrc/atomic_rc_ptr.h>
+#include <cdrc/atomic_weak_ptr.h>
+#include <cdrc/background_reclaimer.h>
+#include <cdrc/drain.h>
+#include <cdrc/rc_ptr.h>
+#include <cdrc/snapshot_ptr.h>
+
+// Announces a quiescent state at the end of every operation
+struct QuiescentStateGuard {
+  ~QuiescentStateGuard() { cdrc::quiescent_state(); }
+};
+
+// A memory management backend together with the guard that
+// must be held while accessing pointers that use it
+template<template<typename> typename Backend, typename Guard>
+struct BackendConfig {
+  template<typename T>
+  using atomic_rc_ptr = cdrc::atomic_rc_ptr<T, Backend<T>>;
+
+  template<typename T>
+  using rc_ptr = cdrc::rc_ptr<T, Backend<T>>;
+
+  template<typename T>
+  using memory_manager = Backend<T>;
+
+  using guard = Guard;
+};
+
+// Backends that allocate their objects from slabs
+template<typename T>
+using hp_slab_backend = cdrc::internal::acquire_retire<T, 7, 2, false, cdrc::slab_allocator>;
+
+template<typename T>
+using ebr_slab_backend = cdrc::internal::acquire_retire_ebr<T, 10, 2, cdrc::slab_allocator>;
+
+template<typename T>
+using hyaline_s_slab_backend = cdrc::internal::acquire_retire_hyaline<T, 2, true, 40, cdrc::slab_allocator>;
+
+// Backend with stamped objects that allocates them from memory resources
+template<typename T>
+using ibr_pmr_backend = cdrc::internal::acquire_retire_ibr<T, 40, 2, cdrc::pmr_allocator>;
+
+template<typename Config>
+class TestBackends : public ::testing::Test { };
+
+using Backends = ::testing::Types<
+  BackendConfig<cdrc::hp_backend, cdrc::empty_guard>,
+  BackendConfig<cdrc::hp_membarrier_backend, cdrc::empty_guard>,
+  BackendConfig<cdrc::ebr_backend, cdrc::epoch_guard>,
+  BackendConfig<cdrc::ibr_backend, cdrc::epoch_guard>,
+  BackendConfig<cdrc::hyaline_backend, cdrc::hyaline_guard>,
+  BackendConfig<cdrc::hyaline_s_backend, cdrc::hyaline_guard>,
+  BackendConfig<cdrc::qsbr_backend, QuiescentStateGuard>,
+  BackendConfig<cdrc::he_backend, cdrc::empty_guard>,
+#if defined(__GCC_HAVE_SYNC_COMPARE_AND_SWAP_16)
+  BackendConfig<cdrc::wfe_backend, cdrc::empty_guard>,
+#endif
+  BackendConfig<hp_slab_backend, cdrc::empty_guard>,
+  BackendConfig<ebr_slab_backend, cdrc::epoch_guard>,
+  BackendConfig<hyaline_s_slab_backend, cdrc::hyaline_guard>,
+  BackendConfig<cdrc::hp_pmr_backend, cdrc::empty_guard>,
+  BackendConfig<ibr_pmr_backend, cdrc::epoch_guard>
+>;
+
+TYPED_TEST_SUITE(TestBackends, Backends);
+
+TYPED_TEST(TestBackends, Seq) {
+  using rc_ptr_t = typename TypeParam::template rc_ptr<int>;
+  using atomic_rc_ptr_t = typename TypeParam::template atomic_rc_ptr<int>;
+  [[maybe_unused]] typename TypeParam::guard g;
+
+  atomic_rc_ptr_t ap;
+  auto x = rc_ptr_t::make_shared(5);
+  ap.store(x);
+  ASSERT_EQ(x.use_count(), 2);
+  ASSERT_EQ(*ap.load(), 5);
+  ASSERT_EQ(*ap.get_snapshot(), 5);
+  ap.store(nullptr);
+  ASSERT_EQ(ap.load(), nullptr);
+}
+
+TYPED_TEST(TestBackends, ParLoadStore) {
+  using rc_ptr_t = typename TypeParam::template rc_ptr<int>;
+  using atomic_rc_ptr_t = typename TypeParam::template atomic_rc_ptr<int>;
+
+  constexpr int N = 4, P = 4, M = 10000;
+  std::vector<atomic_rc_ptr_t> aps(N);
+  for (auto& ap : aps) ap.store(rc_ptr_t::make_shared(0));
+
+  std::vector<std::thread> threads;
+  for (int p = 0; p < P; p++) {
+    threads.emplace_back([&, p]() {
+      for (int i = 0; i < M; i++) {
+        [[maybe_unused]] typename TypeParam::guard g;
+        auto& ap = aps[(i * 7 + p) % N];
+        if (i % 4 == 0) {
+          ap.store(rc_ptr_t::make_shared(i));
+        } else {
+          auto s = ap.get_snapshot();
+          ASSERT_TRUE(s != nullptr);
+          ASSERT_GE(*s, 0);
+          auto r = ap.load();
+          ASSERT_TRUE(r != nullptr);
+          ASSERT_LT(*r, M);
+        }
+      }
+    });
+  }
+  for (auto& t : threads) t.join();
+}
+
+// Storing the same object over and over again leaves many deferred decrements
+// of it in one thread's list, which are applied together when they are ejected
+TYPED_TEST(TestBackends, HotObjectDecrements) {
+  using rc_ptr_t = typename TypeParam::template rc_ptr<int>;
+  using atomic_rc_ptr_t = typename TypeParam::template atomic_rc_ptr<int>;
+
+  auto before = atomic_rc_ptr_t::currently_allocated();
+  {
+    auto hot = rc_ptr_t::make_shared(-1);
+    atomic_rc_ptr_t ap;
+    for (int i = 0; i < 10000; i++) {
+      [[maybe_unused]] typename TypeParam::guard g;
+      ap.store(hot);
+      ap.store(i % 8 == 0 ? rc_ptr_t::make_shared(i) : hot);
+      ASSERT_EQ(*hot, -1);
+      ASSERT_EQ(*ap.load(), i % 8 == 0 ? i : -1);
+    }
+    ASSERT_LT(hot.use_count(), 1000);
+  }
+  // Keep retiring so that the pending decrements, including the last ones of hot, are applied
+  for (int i = 0; i < 10000; i++) {
+    [[maybe_unused]] typename TypeParam::guard g;
+    atomic_rc_ptr_t ap(rc_ptr_t::make_shared(i));
+  }
+  ASSERT_LT(atomic_rc_ptr_t::currently_allocated(), before + 1000);
+}
+
+TYPED_TEST(TestBackends, CloneAndReleaseMany) {
+  using rc_ptr_t = typename TypeParam::template rc_ptr<int>;
+  using atomic_rc_ptr_t = typename TypeParam::template atomic_rc_ptr<int>;
+
+  auto before = atomic_rc_ptr_t::currently_allocated();
+  {
+    [[maybe_unused]] typename TypeParam::guard g;
+    auto x = rc_ptr_t::make_shared(1);
+    auto y = rc_ptr_t::make_shared(2);
+    std::vector<rc_ptr_t> v;
+    x.clone_n(1000, std::back_inserter(v));
+    y.clone_n(10, std::back_inserter(v));
+    ASSERT_EQ(v.size(), 1010);
+    ASSERT_EQ(x.use_count(), 1001);
+    ASSERT_EQ(y.use_count(), 11);
+    ASSERT_EQ(*v[999], 1);
+    ASSERT_EQ(*v[1000], 2);
+
+    // The copies are independent references
+    v[0] = nullptr;
+    ASSERT_EQ(x.use_count(), 1000);
+
+    rc_ptr_t::release_all(v.begin(), v.end());
+    ASSERT_EQ(x.use_count(), 1);
+    ASSERT_EQ(y.use_count(), 1);
+    for (auto& p : v) ASSERT_EQ(p, nullptr);
+
+    // The last references can be released in bulk as well
+    y.clone_n(3, v.begin());
+    y = nullptr;
+    rc_ptr_t::release_all(v.begin(), v.begin() + 3);
+  }
+  ASSERT_EQ(atomic_rc_ptr_t::currently_allocated(), before);
+}
+
+// An object that never has weak pointers taken to it
+struct NoWeakInt {
+  int x;
+  NoWeakInt(int x_) : x(x_) {}
+};
+
+template<>
+struct cdrc::no_weak<NoWeakInt> : std::true_type {};
+
+static_assert(sizeof(cdrc::internal::counted_object<NoWeakInt>) < sizeof(cdrc::internal::counted_object<int>));
+
+TYPED_TEST(TestBackends, NoWeakObjects) {
+  using rc_ptr_t = typename TypeParam::template rc_ptr<NoWeakInt>;
+  using atomic_rc_ptr_t = typename TypeParam::template atomic_rc_ptr<NoWeakInt>;
+
+  auto before = atomic_rc_ptr_t::currently_allocated();
+  {
+    atomic_rc_ptr_t ap(rc_ptr_t::make_shared(0));
+    for (int i = 1; i <= 10000; i++) {
+      [[maybe_unused]] typename TypeParam::guard g;
+      auto x = rc_ptr_t::make_shared(i);
+      ap.store(x);
+      ASSERT_EQ(ap.load()->x, i);
+      ASSERT_EQ(x.use_count(), 2);
+      ASSERT_EQ(x.weak_count(), 0);
+    }
+  }
+  ASSERT_LT(atomic_rc_ptr_t::currently_allocated(), before + 1000);
+}
+
+// An object whose strong and weak counts share a single word
+struct PackedInt {
+  int x;
+  PackedInt(int x_) : x(x_) {}
+};
+
+template<>
+struct cdrc::packed_ref_counts<PackedInt> : std::true_type {};
+
+// The packed word is 8-byte aligned, while the separate counts are 4-byte aligned
+static_assert(sizeof(cdrc::internal::counted_object<int>) < sizeof(cdrc::internal::counted_object<PackedInt>));
+
+TYPED_TEST(TestBackends, PackedObjects) {
+  using rc_ptr_t = typename TypeParam::template rc_ptr<PackedInt>;
+  using atomic_rc_ptr_t = typename TypeParam::template atomic_rc_ptr<PackedInt>;
+
+  auto before = atomic_rc_ptr_t::currently_allocated();
+  {
+    atomic_rc_ptr_t ap(rc_ptr_t::make_shared(0));
+    for (int i = 1; i <= 10000; i++) {
+      [[maybe_unused]] typename TypeParam::guard g;
+      auto x = rc_ptr_t::make_shared(i);
+      ap.store(x);
+      ASSERT_EQ(ap.load()->x, i);
+      ASSERT_EQ(x.use_count(), 2);
+      ASSERT_EQ(x.weak_count(), 0);
+    }
+  }
+  ASSERT_LT(atomic_rc_ptr_t::currently_allocated(), before + 1000);
+}
+
+struct BiasedInt {
+  int x;
+  BiasedInt(int x_) : x(x_) {}
+};
+
+template<>
+struct cdrc::biased_ref_counts<BiasedInt> : std::true_type {};
+
+TYPED_TEST(TestBackends, BiasedObjects) {
+  using rc_ptr_t = typename TypeParam::template rc_ptr<BiasedInt>;
+  using atomic_rc_ptr_t = typename TypeParam::template atomic_rc_ptr<BiasedInt>;
+  constexpr int N = 10000, num_readers = 2;
+
+  auto before = atomic_rc_ptr_t::currently_allocated();
+
+  // Objects that are still owned by a thread that has exited are freed
+  // by whichever thread drops their last reference
+  {
+    std::vector<rc_ptr_t> objects;
+    std::thread owner([&]() {
+      for (int i = 0; i < N; i++) {
+        auto x = rc_ptr_t::make_shared(i);
+        objects.push_back(x);
+        if (i % 2 == 0) objects.push_back(x);
+        ASSERT_EQ(x.use_count(), (i % 2 == 0) ? 3 : 2);
+      }
+    });
+    owner.join();
+    ASSERT_EQ(atomic_rc_ptr_t::currently_allocated(), before + N);
+  }
+  ASSERT_EQ(atomic_rc_ptr_t::currently_allocated(), before);
+
+  // The owner copies its objects locally and publishes them, while the
+  // readers copy and drop them through the shared count
+  {
+    atomic_rc_ptr_t ap(rc_ptr_t::make_shared(0));
+    std::atomic<bool> done = false;
+    std::vector<std::thread> readers;
+    for (int p = 0; p < num_readers; p++) {
+      readers.emplace_back([&]() {
+        while (!done) {
+          [[maybe_unused]] typename TypeParam::guard g;
+          auto x = ap.load();
+          auto y = x;
+          ASSERT_GE(y->x, 0);
+        }
+      });
+    }
+    for (int i = 1; i <= N; i++) {
+      [[maybe_unused]] typename TypeParam::guard g;
+      auto x = rc_ptr_t::make_shared(i);
+      auto y = x;
+      ASSERT_EQ(y.use_count(), 2);
+      ap.store(std::move(y));
+      ASSERT_EQ(x->x, i);
+    }
+    done = true;
+    for (auto& t : readers) t.join();
+
+    // The objects that the readers released last are queued to the owner,
+    // which merges them once it creates more objects
+    for (int i = 1; i <= N; i++) {
+      [[maybe_unused]] typename TypeParam::guard g;
+      ap.store(rc_ptr_t::make_shared(i));
+    }
+  }
+  ASSERT_LT(atomic_rc_ptr_t::currently_allocated(), before + 1000);
+}
+
+struct ImmortalInt {
+  int x;
+  ImmortalInt(int x_) : x(x_) {}
+};
+
+template<>
+struct cdrc::immortal_objects<ImmortalInt> : std::true_type {};
+
+TYPED_TEST(TestBackends, ImmortalObjects) {
+  using rc_ptr_t = typename TypeParam::template rc_ptr<ImmortalInt>;
+  using atomic_rc_ptr_t = typename TypeParam::template atomic_rc_ptr<ImmortalInt>;
+  constexpr int N = 10000, num_readers = 3;
+
+  auto root = rc_ptr_t::make_immortal(42);
+  auto use_count = root.use_count();
+  auto allocated = atomic_rc_ptr_t::currently_allocated();
+  {
+    atomic_rc_ptr_t ap(root);
+    std::vector<std::thread> readers;
+    for (int p = 0; p < num_readers; p++) {
+      readers.emplace_back([&]() {
+        for (int i = 0; i < N; i++) {
+          [[maybe_unused]] typename TypeParam::guard g;
+          auto x = ap.load();
+          auto y = x;
+          ASSERT_EQ(y->x, 42);
+        }
+      });
+    }
+    for (auto& t : readers) t.join();
+
+    // Overwriting and dropping references to it do not free it
+    for (int i = 0; i < N; i++) {
+      [[maybe_unused]] typename TypeParam::guard g;
+      ap.store(root);
+    }
+  }
+  ASSERT_EQ(root.use_count(), use_count);
+  ASSERT_EQ(root->x, 42);
+  root = nullptr;
+  ASSERT_EQ(atomic_rc_ptr_t::currently_allocated(), allocated);
+}
+
+// A node that ends the process when it is destroyed out of order: a mortal node must
+// be destroyed before the immortal node that it points to, which must be destroyed
+template<typename Config>
+struct TeardownNode {
+  inline static bool mortal_destroyed = false;
+  inline static bool immortal_destroyed = false;
+  typename Config::template rc_ptr<TeardownNode> next;
+  bool immortal;
+  TeardownNode(typename Config::template rc_ptr<TeardownNode> next_, bool immortal_)
+    : next(std::move(next_)), immortal(immortal_) {}
+  ~TeardownNode() {
+    if (!immortal) {
+      if (immortal_destroyed) std::_Exit(2);
+      mortal_destroyed = true;
+    }
+    else {
+      immortal_destroyed = true;
+      std::_Exit(mortal_destroyed ? 0 : 3);
+    }
+  }
+};
+
+template<typename Config>
+struct cdrc::immortal_objects<TeardownNode<Config>> : std::true_type {};
+
+// The memory manager is destroyed at exit while the release of a node that points to
+// an immortal node is still deferred. The immortal node must outlive the deferred release.
+TYPED_TEST(TestBackends, ImmortalObjectsOutliveDeferredReleases) {
+  using node_t = TeardownNode<TypeParam>;
+  using rc_ptr_t = typename TypeParam::template rc_ptr<node_t>;
+  using atomic_rc_ptr_t = typename TypeParam::template atomic_rc_ptr<node_t>;
+
+  EXPECT_EXIT({
+    auto sentinel = rc_ptr_t::make_immortal(nullptr, true);
+    {
+      [[maybe_unused]] typename TypeParam::guard g;
+      atomic_rc_ptr_t ap(rc_ptr_t::make_shared(sentinel, false));
+      ap.store(nullptr);
+    }
+    sentinel = nullptr;
+    std::exit(4);
+  }, ::testing::ExitedWithCode(0), "");
+}
+
+// Counts the live objects that were created with a nonnegative value, separately for each Config
+template<typename Config>
+struct ChurnInt {
+  inline static std::atomic<int> live = 0;
+  int x;
+  ChurnInt(int x_) : x(x_) { if (x >= 0) live++; }
+  ~ChurnInt() { if (x >= 0) live--; }
+};
+
+// Several threads retire a few objects each, too few to ever eject them, and then exit.
+// The objects that they left behind are reclaimed by the thread that remains.
+TYPED_TEST(TestBackends, ExitedThreadsHandOffDeferredRetires) {
+  using churn_int = ChurnInt<TypeParam>;
+  using rc_ptr_t = typename TypeParam::template rc_ptr<churn_int>;
+  using atomic_rc_ptr_t = typename TypeParam::template atomic_rc_ptr<churn_int>;
+  constexpr int num_threads = 4, per_thread = 25, N = 2000;
+
+  std::atomic<int> finished = 0;
+  std::vector<std::thread> threads;
+  for (int p = 0; p < num_threads; p++) {
+    threads.emplace_back([&]() {
+      {
+        atomic_rc_ptr_t ap(rc_ptr_t::make_shared(0));
+        for (int i = 1; i < per_thread; i++) {
+          [[maybe_unused]] typename TypeParam::guard g;
+          ap.store(rc_ptr_t::make_shared(i));
+        }
+      }
+      // Stay alive until every thread is done, so that they all have different IDs
+      finished++;
+      while (finished.load() < num_threads) std::this_thread::yield();
+    });
+  }
+  for (auto& t : threads) t.join();
+
+  {
+    atomic_rc_ptr_t ap(rc_ptr_t::make_shared(-1));
+    for (int i = 1; i <= N; i++) {
+      [[maybe_unused]] typename TypeParam::guard g;
+      ap.store(rc_ptr_t::make_shared(-i));
+    }
+  }
+  ASSERT_EQ(churn_int::live.load(), 0);
+}
+
+// A linked list node that counts the live nodes, separately for each Config
+template<typename Config>
+struct DrainNode {
+  inline static std::atomic<int> live = 0;
+  typename Config::template atomic_rc_ptr<DrainNode> next;
+  DrainNode() { live++; }
+  ~DrainNode() { live--; }
+};
+
+// Dropping a list retires only its head, and each node that is destroyed retires its
+// successor, so draining the list takes one pass per node
+TYPED_TEST(TestBackends, DrainFreesEveryUnprotectedObject) {
+  using node_type = DrainNode<TypeParam>;
+  using rc_ptr_t = typename TypeParam::template rc_ptr<node_type>;
+  using atomic_rc_ptr_t = typename TypeParam::template atomic_rc_ptr<node_type>;
+  using memory_manager = typename TypeParam::template memory_manager<node_type>;
+  constexpr int N = 20;
+
+  atomic_rc_ptr_t head;
+  {
+    [[maybe_unused]] typename TypeParam::guard g;
+    for (int i = 0; i < N; i++) {
+      auto node = rc_ptr_t::make_shared();
+      node->next.store(head.load());
+      head.store(std::move(node));
+    }
+    head.store(nullptr);
+  }
+  ASSERT_GT(node_type::live.load(), 0);
+
+  ASSERT_EQ(cdrc::drain<memory_manager>(), N);
+  ASSERT_EQ(node_type::live.load(), 0);
+  ASSERT_EQ(cdrc::drain<memory_manager>(), 0);
+}
+
+// Slots that one thread frees after another thread allocated them must
+// make their way back to the allocating thread rather than pile up
+TEST(TestSlabAllocator, CrossThreadFreesAreReused) {
+  using object_t = std::array<char, 40>;
+  cdrc::slab_allocator<object_t> allocator;
+  constexpr size_t N = 10000, rounds = 20;
+
+  // The producer allocates on even stages and the consumer frees on odd stages
+  std::vector<object_t*> objects;
+  std::atomic<size_t> stage = 0;
+  std::thread producer([&]() {
+    for (size_t round = 0; round < rounds; round++) {
+      while (stage != 2 * round) std::this_thread::yield();
+      for (size_t i = 0; i < N; i++) objects.push_back(allocator.create());
+      stage++;
+    }
+  });
+  std::thread consumer([&]() {
+    for (size_t round = 0; round < rounds; round++) {
+      while (stage != 2 * round + 1) std::this_thread::yield();
+      for (auto p : objects) allocator.destroy(p);
+      objects.clear();
+      stage++;
+    }
+  });
+  producer.join();
+  consumer.join();
+  ASSERT_LT(allocator.capacity(), 3 * N);
+}
+
+// An object whose constructor always throws
+struct ThrowingObject {
+  std::array<char, 200> data;
+  ThrowingObject() { throw std::runtime_error("ThrowingObject"); }
+};
+
+// The slot of an object whose constructor throws goes back to the pool
+TEST(TestSlabAllocator, ThrowingConstructorReturnsTheSlot) {
+  cdrc::slab_allocator<ThrowingObject> allocator;
+  constexpr size_t N = 10000;
+
+  for (size_t i = 0; i < N; i++) {
+    ASSERT_THROW(allocator.create(), std::runtime_error);
+  }
+  ASSERT_LT(allocator.capacity(), N);
+}
+
+// A memory resource that counts the allocations and bytes that it hands out
+struct CountingResource : std::pmr::memory_resource {
+  std::atomic<size_t> allocations = 0;
+  std::atomic<size_t> outstanding = 0;
+
+  void* do_allocate(size_t bytes, size_t align) override {
+    allocations++;
+    outstanding += bytes;
+    return std::pmr::new_delete_resource()->allocate(bytes, align);
+  }
+
+  void do_deallocate(void* p, size_t bytes, size_t align) override {
+    outstanding -= bytes;
+    std::pmr::new_delete_resource()->deallocate(p, bytes, align);
+  }
+
+  bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+};
+
+TEST(TestPmrAllocator, ObjectsAreReturnedToTheirResource) {
+  using rc_ptr_t = cdrc::rc_ptr<int, cdrc::hp_pmr_backend<int>>;
+  using atomic_rc_ptr_t = cdrc::atomic_rc_ptr<int, cdrc::hp_pmr_backend<int>>;
+  constexpr int N = 10000;
+
+  CountingResource a, b;
+  std::vector<rc_ptr_t> objects;
+  for (int i = 0; i < N; i++) {
+    objects.push_back(cdrc::allocate_rc<int>(i % 2 == 0 ? &a : &b, i));
+  }
+  ASSERT_EQ(a.allocations, N / 2);
+  ASSERT_EQ(b.allocations, N / 2);
+
+  // Another thread releases the objects through deferred decrements, and then
+  // stores enough objects from the default resource to eject all of them
+  atomic_rc_ptr_t ap;
+  std::thread other([&]() {
+    for (int i = 0; i < N; i++) {
+      ap.store(std::move(objects[i]));
+      ASSERT_EQ(*ap.load(), i);
+    }
+    for (int i = 0; i < 1000; i++) {
+      ap.store(rc_ptr_t::make_shared(-1));
+    }
+  });
+  other.join();
+  ASSERT_EQ(a.outstanding, 0);
+  ASSERT_EQ(b.outstanding, 0);
+}
+
+TEST(TestPmrAllocator, AllocateFromArena) {
+  alignas(std::max_align_t) unsigned char buffer[4096];
+  std::pmr::monotonic_buffer_resource arena(buffer, sizeof(buffer), std::pmr::null_memory_resource());
+
+  auto in_buffer = [&](const void* p) {
+    auto q = static_cast<const unsigned char*>(p);
+    return q >= buffer && q < buffer + sizeof(buffer);
+  };
+  {
+    auto x = cdrc::allocate_rc<std::array<int, 4>>(&arena);
+    auto y = cdrc::allocate_rc<int>(&arena, 5);
+    auto z = cdrc::rc_ptr<int, cdrc::hp_pmr_backend<int>>::make_shared(6);
+    ASSERT_TRUE(in_buffer(x.get()));
+    ASSERT_TRUE(in_buffer(y.get()));
+    ASSERT_FALSE(in_buffer(z.get()));
+    ASSERT_EQ(*y, 5);
+    ASSERT_EQ(*z, 6);
+  }
+}
+
+TEST(TestQsbr, ReclaimAfterQuiescentStates) {
+  using atomic_rc_ptr_t = cdrc::atomic_rc_ptr_qsbr<int>;
+  using rc_ptr_t = cdrc::rc_ptr_qsbr<int>;
+
+  // Objects retired by threads that have since exited are not counted
+  auto before = atomic_rc_ptr_t::currently_allocated();
+  atomic_rc_ptr_t ap(rc_ptr_t::make_shared(0));
+  for (int i = 1; i <= 10000; i++) {
+    ap.store(rc_ptr_t::make_shared(i));
+    ASSERT_EQ(*ap.get_snapshot(), i);
+    cdrc::quiescent_state();
+  }
+  ASSERT_LT(atomic_rc_ptr_t::currently_allocated(), before + 1000);
+  cdrc::qsbr_offline();
+}
+
+TEST(TestQsbr, OnlineThreadHoldsBackReclamation) {
+  using atomic_rc_ptr_t = cdrc::atomic_rc_ptr_qsbr<int>;
+  using rc_ptr_t = cdrc::rc_ptr_qsbr<int>;
+
+  atomic_rc_ptr_t ap(rc_ptr_t::make_shared(0));
+  std::atomic<int> stage{0};
+
+  // A reader that goes online and then stops announcing quiescent states
+  std::thread reader([&]() {
+    cdrc::qsbr_online();
+    auto s = ap.get_snapshot();
+    stage = 1;
+    while (stage != 2) std::this_thread::yield();
+    ASSERT_EQ(*s, 0);
+    s.clear();
+    cdrc::qsbr_offline();
+    stage = 3;
+    while (stage != 4) std::this_thread::yield();
+  });
+
+  while (stage != 1) std::this_thread::yield();
+  auto before = atomic_rc_ptr_t::currently_allocated();
+  for (int i = 1; i <= 5000; i++) {
+    ap.store(rc_ptr_t::make_shared(i));
+    cdrc::quiescent_state();
+  }
+  auto peak = atomic_rc_ptr_t::currently_allocated();
+  ASSERT_GE(peak, before + 4000);
+
+  stage = 2;
+  while (stage != 3) std::this_thread::yield();
+  for (int i = 1; i <= 5000; i++) {
+    ap.store(rc_ptr_t::make_shared(i));
+    cdrc::quiescent_state();
+  }
+  ASSERT_LT(atomic_rc_ptr_t::currently_allocated() + 4000, peak);
+
+  stage = 4;
+  reader.join();
+  cdrc::qsbr_offline();
+}
+
+template<typename Config>
+class TestEras : public ::testing::Test { };
+
+using EraBackends = ::testing::Types<
+#if defined(__GCC_HAVE_SYNC_COMPARE_AND_SWAP_16)
+  BackendConfig<cdrc::wfe_backend, cdrc::empty_guard>,
+#endif
+  BackendConfig<cdrc::he_backend, cdrc::empty_guard>
+>;
+
+TYPED_TEST_SUITE(TestEras, EraBackends);
+
+// A reader that stalls while holding a snapshot only pins the
+// objects that were alive in the era it announced
+TYPED_TEST(TestEras, StalledReaderPinsBoundedMemory) {
+  using rc_ptr_t = typename TypeParam::template rc_ptr<int>;
+  using atomic_rc_ptr_t = typename TypeParam::template atomic_rc_ptr<int>;
+
+  atomic_rc_ptr_t ap(rc_ptr_t::make_shared(0));
+  std::atomic<int> stage = 0;
+
+  std::thread reader([&]() {
+    auto s = ap.get_snapshot();
+    ASSERT_EQ(*s, 0);
+    stage = 1;
+    while (stage != 2) std::this_thread::yield();
+  });
+
+  while (stage != 1) std::this_thread::yield();
+  auto before = atomic_rc_ptr_t::currently_allocated();
+  for (int i = 1; i <= 20000; i++) {
+    ap.store(rc_ptr_t::make_shared(i));
+  }
+  ASSERT_LT(atomic_rc_ptr_t::currently_allocated(), before + 5000);
+
+  stage = 2;
+  reader.join();
+}
+
+// Objects whose deferred actions are applied at most four per retire
+struct BudgetedInt {
+  inline static std::atomic<int> destroyed = 0;
+  int x;
+  BudgetedInt(int x_) : x(x_) {}
+  ~BudgetedInt() { destroyed++; }
+};
+
+template<>
+struct cdrc::eject_budget<BudgetedInt> : std::integral_constant<size_t, 4> {};
+
+template<typename Config>
+class TestEjectBudget : public ::testing::Test { };
+
+using ListBackends = ::testing::Types<
+  BackendConfig<cdrc::hp_backend, cdrc::empty_guard>,
+  BackendConfig<cdrc::ebr_backend, cdrc::epoch_guard>,
+  BackendConfig<cdrc::ibr_backend, cdrc::epoch_guard>,
+  BackendConfig<cdrc::qsbr_backend, QuiescentStateGuard>,
+#if defined(__GCC_HAVE_SYNC_COMPARE_AND_SWAP_16)
+  BackendConfig<cdrc::wfe_backend, cdrc::empty_guard>,
+#endif
+  BackendConfig<cdrc::he_backend, cdrc::empty_guard>
+>;
+
+TYPED_TEST_SUITE(TestEjectBudget, ListBackends);
+
+// Every store retires the object that it replaces, and the pass that is triggered every few
+// stores finds dozens of them safe to destroy, which are then destroyed a few at a time
+TYPED_TEST(TestEjectBudget, RetireAppliesAtMostBudget) {
+  using rc_ptr_t = typename TypeParam::template rc_ptr<BudgetedInt>;
+  using atomic_rc_ptr_t = typename TypeParam::template atomic_rc_ptr<BudgetedInt>;
+
+  auto before = atomic_rc_ptr_t::currently_allocated();
+  {
+    atomic_rc_ptr_t ap(rc_ptr_t::make_shared(0));
+    for (int i = 1; i <= 10000; i++) {
+      [[maybe_unused]] typename TypeParam::guard g;
+      auto x = rc_ptr_t::make_shared(i);
+      int destroyed = BudgetedInt::destroyed;
+      ap.store(std::move(x));
+      ASSERT_LE(BudgetedInt::destroyed - destroyed, 4);
+      ASSERT_EQ(ap.load()->x, i);
+    }
+    // The queued ejects are applied faster than objects are retired
+    ASSERT_LT(atomic_rc_ptr_t::currently_allocated(), before + 1000);
+  }
+}
+
+// Objects whose deferred actions are applied for at most a microsecond per retire
+struct TimedInt {
+  int x;
+  TimedInt(int x_) : x(x_) {}
+};
+
+template<>
+struct cdrc::eject_time_budget<TimedInt> : std::integral_constant<size_t, 1> {};
+
+// A time budget alone still keeps up with the retires, since each retire does at least a slice
+TYPED_TEST(TestEjectBudget, TimeBudgetKeepsUp) {
+  using rc_ptr_t = typename TypeParam::template rc_ptr<TimedInt>;
+  using atomic_rc_ptr_t = typename TypeParam::template atomic_rc_ptr<TimedInt>;
+
+  auto before = atomic_rc_ptr_t::currently_allocated();
+  {
+    atomic_rc_ptr_t ap(rc_ptr_t::make_shared(0));
+    for (int i = 1; i <= 10000; i++) {
+      [[maybe_unused]] typename TypeParam::guard g;
+      ap.store(rc_ptr_t::make_shared(i));
+      ASSERT_EQ(ap.load()->x, i);
+    }
+    ASSERT_LT(atomic_rc_ptr_t::currently_allocated(), before + 1000);
+  }
+}
+
+// Objects whose deferred actions are limited by a soft or a hard limit alone
+struct SoftLimitedInt {
+  int x;
+  SoftLimitedInt(int x_) : x(x_) {}
+};
+
+struct HardLimitedInt {
+  int x;
+  HardLimitedInt(int x_) : x(x_) {}
+};
+
+template<>
+struct cdrc::deferred_limits<SoftLimitedInt> {
+  constexpr static size_t soft = 8;
+  constexpr static size_t hard = 0;
+};
+
+template<>
+struct cdrc::deferred_limits<HardLimitedInt> {
+  constexpr static size_t soft = 0;
+  constexpr static size_t hard = 16;
+};
+
+template<typename Config>
+class TestDeferredLimits : public ::testing::Test { };
+
+TYPED_TEST_SUITE(TestDeferredLimits, ListBackends);
+
+// Backends that keep freeing the objects that a preempted thread does not protect, which
+// EBR and QSBR can not do while it is inside a critical section
+using StallTolerantBackends = ::testing::Types<
+  BackendConfig<cdrc::hp_backend, cdrc::empty_guard>,
+  BackendConfig<cdrc::ibr_backend, cdrc::epoch_guard>,
+#if defined(__GCC_HAVE_SYNC_COMPARE_AND_SWAP_16)
+  BackendConfig<cdrc::wfe_backend, cdrc::empty_guard>,
+#endif
+  BackendConfig<cdrc::he_backend, cdrc::empty_guard>
+>;
+
+template<typename Config>
+class TestHardLimit : public ::testing::Test { };
+
+TYPED_TEST_SUITE(TestHardLimit, StallTolerantBackends);
+
+// Store over and over again, and return the largest number of objects that were allocated
+template<typename Config, typename U>
+std::ptrdiff_t store_many_limited() {
+  using rc_ptr_t = typename Config::template rc_ptr<U>;
+  using atomic_rc_ptr_t = typename Config::template atomic_rc_ptr<U>;
+
+  std::ptrdiff_t before = atomic_rc_ptr_t::currently_allocated(), peak = 0;
+  atomic_rc_ptr_t ap(rc_ptr_t::make_shared(0));
+  for (int i = 1; i <= 10000; i++) {
+    [[maybe_unused]] typename Config::guard g;
+    ap.store(rc_ptr_t::make_shared(i));
+    EXPECT_EQ(ap.load()->x, i);
+    peak = std::max<std::ptrdiff_t>(peak, atomic_rc_ptr_t::currently_allocated() - before);
+  }
+  return peak;
+}
+
+// A pass would otherwise only be triggered every 30 retires, or more once earlier tests have
+// used more thread IDs. Past the soft limit, passes are triggered at least every soft limit
+// retires, and past the hard limit, by every retire.
+TYPED_TEST(TestDeferredLimits, RetiresKeepDeferredActionsNearSoftLimit) {
+  using soft_manager = typename TypeParam::template memory_manager<SoftLimitedInt>;
+
+  ASSERT_LE((store_many_limited<TypeParam, SoftLimitedInt>()), 48);
+  ASSERT_GT(soft_manager::instance().deferred_limit_hits().soft, 0);
+  ASSERT_EQ(soft_manager::instance().deferred_limit_hits().hard, 0);
+}
+
+TYPED_TEST(TestHardLimit, RetiresKeepDeferredActionsUnderHardLimit) {
+  using hard_manager = typename TypeParam::template memory_manager<HardLimitedInt>;
+
+  ASSERT_LE((store_many_limited<TypeParam, HardLimitedInt>()), 20);
+  ASSERT_EQ(hard_manager::instance().deferred_limit_hits().soft, 0);
+  ASSERT_GT(hard_manager::instance().deferred_limit_hits().hard, 0);
+  ASSERT_EQ(hard_manager::instance().deferred_limit_hits().breaches, 0);
+}
+
+// Objects with both limits, for the test that stalls a reader. The passes past the soft limit
+// advance the era soon after the reader stalls, which bounds the objects that it protects.
+struct StalledLimitedInt {
+  int x;
+  StalledLimitedInt(int x_) : x(x_) {}
+};
+
+template<>
+struct cdrc::deferred_limits<StalledLimitedInt> {
+  constexpr static size_t soft = 8;
+  constexpr static size_t hard = 32;
+};
+
+// A reader stalls inside a guard holding a snapshot, while the writer stores over and over
+// again. The objects created once the era or epoch has moved on from the one that the reader
+// announced are never protected by it, so the number allocated stays under the hard limit,
+// plus the one in the pointer and the snapshot.
+TYPED_TEST(TestHardLimit, StalledReaderDoesNotRaiseCeiling) {
+  using rc_ptr_t = typename TypeParam::template rc_ptr<StalledLimitedInt>;
+  using atomic_rc_ptr_t = typename TypeParam::template atomic_rc_ptr<StalledLimitedInt>;
+  using memory_manager = typename TypeParam::template memory_manager<StalledLimitedInt>;
+  constexpr std::ptrdiff_t hard = cdrc::deferred_limits<StalledLimitedInt>::hard;
+
+  std::ptrdiff_t before = atomic_rc_ptr_t::currently_allocated(), peak = 0;
+  auto breaches = memory_manager::instance().deferred_limit_hits().breaches;
+  atomic_rc_ptr_t ap(rc_ptr_t::make_shared(0));
+  std::atomic<int> stage = 0;
+
+  std::thread reader([&]() {
+    [[maybe_unused]] typename TypeParam::guard g;
+    auto s = ap.get_snapshot();
+    stage = 1;
+    while (stage != 2) std::this_thread::yield();
+    EXPECT_EQ(s->x, 0);
+  });
+  while (stage != 1) std::this_thread::yield();
+
+  for (int i = 1; i <= 10000; i++) {
+    [[maybe_unused]] typename TypeParam::guard g;
+    ap.store(rc_ptr_t::make_shared(i));
+    peak = std::max<std::ptrdiff_t>(peak, atomic_rc_ptr_t::currently_allocated() - before);
+  }
+  stage = 2;
+  reader.join();
+
+  ASSERT_LE(peak, hard + 4);
+  ASSERT_EQ(memory_manager::instance().deferred_limit_hits().breaches, breaches);
+}
+
+// Objects that a reader can stall with in the eras in which they were alive
+struct PinnedLimitedInt {
+  int x;
+  PinnedLimitedInt(int x_) : x(x_) {}
+};
+
+template<>
+struct cdrc::deferred_limits<PinnedLimitedInt> {
+  constexpr static size_t soft = 0;
+  constexpr static size_t hard = 16;
+};
+
+// A reader that stalls after announcing an era protects every object that was alive in it,
+// so when more than the hard limit of them are retired, no pass can bring the count back
+// under the limit, and the passes report breaches
+TEST(TestHardLimit, PinnedObjectsAreReportedAsBreaches) {
+  using rc_ptr_t = cdrc::rc_ptr<PinnedLimitedInt, cdrc::he_backend<PinnedLimitedInt>>;
+  using atomic_rc_ptr_t = cdrc::atomic_rc_ptr<PinnedLimitedInt, cdrc::he_backend<PinnedLimitedInt>>;
+  using memory_manager = cdrc::he_backend<PinnedLimitedInt>;
+
+  std::vector<atomic_rc_ptr_t> slots(64);
+  for (int i = 0; i < 64; i++) slots[i].store(rc_ptr_t::make_shared(i));
+  std::atomic<int> stage = 0;
+
+  std::thread reader([&]() {
+    auto s = slots[0].get_snapshot();
+    stage = 1;
+    while (stage != 2) std::this_thread::yield();
+    EXPECT_EQ(s->x, 0);
+  });
+  while (stage != 1) std::this_thread::yield();
+
+  for (int i = 0; i < 64; i++) slots[i].store(rc_ptr_t::make_shared(64 + i));
+  ASSERT_GT(memory_manager::instance().deferred_limit_hits().breaches, 0);
+  stage = 2;
+  reader.join();
+}
+
+// Objects whose soft limit is above the number of retires between the passes of a thread
+struct SharedSoftLimitedInt {
+  int x;
+  SharedSoftLimitedInt(int x_) : x(x_) {}
+};
+
+template<>
+struct cdrc::deferred_limits<SharedSoftLimitedInt> {
+  constexpr static size_t soft = 128;
+  constexpr static size_t hard = 0;
+};
+
+template<typename Config>
+class TestSharedSoftLimit : public ::testing::Test { };
+
+TYPED_TEST_SUITE(TestSharedSoftLimit, StallTolerantBackends);
+
+// Threads store over and over again into pointers of their own. Past the soft limit, each
+// thread makes a pass every few retires however many threads there are, so the number of
+// objects allocated stays near the soft limit as the number of threads grows, rather than
+// growing with the number of retires between the passes of every thread
+TYPED_TEST(TestSharedSoftLimit, HoldsAsThreadsGrow) {
+  using rc_ptr_t = typename TypeParam::template rc_ptr<SharedSoftLimitedInt>;
+  using atomic_rc_ptr_t = typename TypeParam::template atomic_rc_ptr<SharedSoftLimitedInt>;
+  constexpr std::ptrdiff_t soft = cdrc::deferred_limits<SharedSoftLimitedInt>::soft;
+
+  for (int num_threads : {1, 2, 4, 8, 16, 32}) {
+    std::ptrdiff_t before = atomic_rc_ptr_t::currently_allocated();
+    std::atomic<std::ptrdiff_t> peak = 0;
+    std::vector<std::thread> threads;
+    for (int p = 0; p < num_threads; p++) {
+      threads.emplace_back([&]() {
+        atomic_rc_ptr_t ap(rc_ptr_t::make_shared(0));
+        for (int i = 1; i <= 20000; i++) {
+          [[maybe_unused]] typename TypeParam::guard g;
+          ap.store(rc_ptr_t::make_shared(i));
+          std::ptrdiff_t allocated = atomic_rc_ptr_t::currently_allocated() - before;
+          auto current = peak.load();
+          while (allocated > current && !peak.compare_exchange_weak(current, allocated)) {}
+        }
+      });
+    }
+    for (auto& t : threads) t.join();
+    ASSERT_LE(peak.load(), 2 * soft + 8 * num_threads);
+  }
+}
+
+struct ExemptInt {
+  inline static thread_local int destroyed_here = 0;
+  int x;
+  ExemptInt(int x_) : x(x_) {}
+  ~ExemptInt() { destroyed_here++; }
+};
+
+template<typename Config>
+class TestBackgroundReclaimer : public ::testing::Test { };
+
+TYPED_TEST_SUITE(TestBackgroundReclaimer, ListBackends);
+
+// An exempt thread never destroys objects in its stores, and the background
+// reclaimer destroys the objects that it retired instead
+TYPED_TEST(TestBackgroundReclaimer, ExemptThreadHandsOffEjects) {
+  using rc_ptr_t = typename TypeParam::template rc_ptr<ExemptInt>;
+  using atomic_rc_ptr_t = typename TypeParam::template atomic_rc_ptr<ExemptInt>;
+  using memory_manager = typename TypeParam::template memory_manager<ExemptInt>;
+
+  auto before = atomic_rc_ptr_t::currently_allocated();
+  {
+    cdrc::background_reclaimer<memory_manager> reclaimer;
+    cdrc::set_reclamation_exempt();
+    atomic_rc_ptr_t ap(rc_ptr_t::make_shared(0));
+    for (int i = 1; i <= 10000; i++) {
+      [[maybe_unused]] typename TypeParam::guard g;
+      ap.store(rc_ptr_t::make_shared(i));
+      ASSERT_EQ(ap.load()->x, i);
+    }
+    ASSERT_EQ(ExemptInt::destroyed_here, 0);
+    cdrc::set_reclamation_exempt(false);
+
+    for (int i = 0; i < 5000 && atomic_rc_ptr_t::currently_allocated() >= before + 1000; i++) {
+      [[maybe_unused]] typename TypeParam::guard g;
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    ASSERT_LT(atomic_rc_ptr_t::currently_allocated(), before + 1000);
+  }
+}
+
+// Hyaline retires objects in batches, which may mix strong
+// and weak count decrements that must each be applied correctly
+TEST(TestHyaline, MixedRetireTypes) {
+  using rc_ptr_t = cdrc::rc_ptr_hyaline<int>;
+  using atomic_rc_ptr_t = cdrc::atomic_rc_ptr_hyaline<int>;
+  using atomic_weak_ptr_t = cdrc::atomic_weak_ptr_hyaline<int>;
+
+  auto before = atomic_rc_ptr_t::currently_allocated();
+  {
+    atomic_rc_ptr_t ap;
+    atomic_weak_ptr_t awp;
+    for (int i = 0; i < 10000; i++) {
+      cdrc::hyaline_guard g;
+      auto x = rc_ptr_t::make_shared(i);
+      ap.store(x);
+      awp.store(x);
+      ASSERT_EQ(*awp.get_snapshot(), i);
+    }
+  }
+  ASSERT_LT(atomic_rc_ptr_t::currently_allocated(), before + 1000);
+}
+
+// A thread that stalls inside a guard must not pin the batches
+// made only of objects that were created after its last read
+TEST(TestHyaline, RobustStalledThreadPinsBoundedMemory) {
+  using rc_ptr_t = cdrc::rc_ptr_hyaline_s<int>;
+  using atomic_rc_ptr_t = cdrc::atomic_rc_ptr_hyaline_s<int>;
+
+  atomic_rc_ptr_t ap(rc_ptr_t::make_shared(0));
+  std::atomic<int> stage = 0;
+
+  std::thread reader([&]() {
+    cdrc::hyaline_guard g;
+    auto s = ap.get_snapshot();
+    ASSERT_EQ(*s, 0);
+    stage = 1;
+    while (stage != 2) std::this_thread::yield();
+  });
+
+  while (stage != 1) std::this_thread::yield();
+  auto before = atomic_rc_ptr_t::currently_allocated();
+  for (int i = 1; i <= 20000; i++) {
+    cdrc::hyaline_guard g;
+    ap.store(rc_ptr_t::make_shared(i));
+  }
+  ASSERT_LT(atomic_rc_ptr_t::currently_allocated(), before + 5000);
+
+  stage = 2;
+  reader.join();
+}
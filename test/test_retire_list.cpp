@@ -0,0 +1,209 @@
+#include "gtest/gtest.h"
+
+#include <algorithm>
+#include <vector>
+
+#include <cdrc/internal/retire_list.h>
+
+using cdrc::internal::retire_list;
+
+template<typename Iterator>
+std::vector<int> collect(Iterator first, Iterator last) {
+  std::vector<int> result(first, last);
+  std::sort(result.begin(), result.end());
+  return result;
+}
+
+TEST(TestRetireList, SweepKeepsSurvivorsAndNewEntries) {
+  retire_list<int> list;
+  for (int i = 0; i < 1000; i++) list.push_back(i);
+  ASSERT_EQ(list.size(), 1000);
+
+  // Eject the multiples of three, and retire one more entry per ejected entry
+  std::vector<int> ejected;
+  auto removed = list.sweep([](int x) { return x % 3 != 0; }, [&](auto first, auto last) {
+    ejected = collect(first, last);
+    for (auto x : ejected) list.push_back(1000 + x);
+  });
+  ASSERT_EQ(removed, 334);
+
+  ASSERT_EQ(ejected.size(), 334);
+  for (size_t i = 0; i < ejected.size(); i++) ASSERT_EQ(ejected[i], 3 * static_cast<int>(i));
+  ASSERT_EQ(list.size(), 666 + 334);
+
+  auto remaining = collect(list.begin(), list.end());
+  ASSERT_EQ(remaining.size(), list.size());
+  for (int i = 0; i < 1000; i++) {
+    bool kept = (i % 3 != 0);
+    ASSERT_EQ(std::binary_search(remaining.begin(), remaining.end(), i), kept);
+    ASSERT_EQ(std::binary_search(remaining.begin(), remaining.end(), 1000 + i), !kept);
+  }
+
+  // Eject everything
+  ASSERT_EQ(list.sweep([](int) { return false; }, [](auto, auto) {}), 1000);
+  ASSERT_TRUE(list.empty());
+  ASSERT_EQ(list.begin(), list.end());
+}
+
+TEST(TestRetireList, SweepStampedBefore) {
+  retire_list<int> list;
+  for (int i = 0; i < 500; i++) list.push_back(i, i / 100);
+
+  std::vector<int> ejected;
+  ASSERT_EQ(list.sweep_stamped_before(3, [&](auto first, auto last) { ejected = collect(first, last); }), 300);
+  ASSERT_EQ(ejected.size(), 300);
+  ASSERT_EQ(ejected.back(), 299);
+  ASSERT_EQ(list.size(), 200);
+  ASSERT_EQ(*list.begin(), 300);
+
+  // Nothing was retired before the oldest remaining stamp
+  ASSERT_EQ(list.sweep_stamped_before(3, [&](auto, auto) { FAIL(); }), 0);
+  ASSERT_EQ(list.size(), 200);
+
+  list.sweep_stamped_before(10, [](auto, auto) {});
+  ASSERT_TRUE(list.empty());
+  list.push_back(7, 10);
+  ASSERT_EQ(list.size(), 1);
+  ASSERT_EQ(*list.begin(), 7);
+}
+
+// Each entry is stamped with its value divided by ten, so a stamp that is seen for an entry
+// must never be less than that
+TEST(TestRetireList, SweepWithStampsNeverLowersStamps) {
+  retire_list<int> list;
+  for (int i = 0; i < 1000; i++) list.push_back(i, i / 10);
+
+  // Keep one entry in every seven, which spreads them over many stamps
+  auto check = [](int x, uint64_t stamp) {
+    EXPECT_GE(stamp, static_cast<uint64_t>(x / 10));
+    return x % 7 == 0;
+  };
+  std::vector<int> ejected;
+  auto removed = list.sweep_with_stamps(check, [&](auto first, auto last) {
+    ejected = collect(first, last);
+    for (int i = 0; i < 5; i++) list.push_back(2000 + i, 200);
+  });
+  ASSERT_EQ(removed, 1000 - 143);
+  ASSERT_EQ(ejected.size(), removed);
+  ASSERT_EQ(list.size(), 143 + 5);
+
+  // The entries that were kept are in order at the front of the list
+  std::vector<int> remaining(list.begin(), list.end());
+  for (int i = 0; i < 143; i++) ASSERT_EQ(remaining[i], 7 * i);
+  for (int i = 0; i < 5; i++) ASSERT_EQ(remaining[143 + i], 2000 + i);
+
+  // The kept entries are packed densely, so the stamps that they move to are those of
+  // nearby entries rather than of the newest one
+  std::vector<int> seen;
+  list.sweep_with_stamps([&](int x, uint64_t stamp) {
+    EXPECT_GE(stamp, static_cast<uint64_t>(x / 10));
+    if (x < 1000) {
+      EXPECT_LT(stamp, 100u);
+    }
+    seen.push_back(x);
+    return x >= 1000;
+  }, [](auto, auto) {});
+  ASSERT_EQ(seen.size(), 148);
+  ASSERT_EQ(list.size(), 5);
+  ASSERT_EQ(*list.begin(), 2000);
+
+  ASSERT_EQ(list.sweep_with_stamps([](int, uint64_t) { return false; }, [](auto, auto) {}), 5);
+  ASSERT_TRUE(list.empty());
+}
+
+// A sweep made a few entries at a time only examines the entries that were in the list
+// when it started, and never more than its limit per call
+TEST(TestRetireList, SweepSomeResumes) {
+  retire_list<int> list;
+  for (int i = 0; i < 1000; i++) list.push_back(i, i / 10);
+
+  std::vector<int> examined, ejected;
+  auto keep = [&](int x, uint64_t stamp) {
+    EXPECT_GE(stamp, static_cast<uint64_t>(x / 10));
+    examined.push_back(x);
+    return x % 4 == 0;
+  };
+  size_t removed = 0, calls = 0;
+  do {
+    auto before = examined.size();
+    removed += list.sweep_some(16, keep, [&](int x) { ejected.push_back(x); });
+    ASSERT_LE(examined.size() - before, 16u);
+    // Entries appended during the sweep are left for the next one
+    list.push_back(5000 + static_cast<int>(calls), 500);
+    calls++;
+  } while (list.sweeping());
+  ASSERT_EQ(calls, 1000u / 16 + 1);
+  ASSERT_EQ(removed, 750u);
+  ASSERT_EQ(ejected.size(), 750u);
+  ASSERT_EQ(examined.size(), 1000u);
+  ASSERT_EQ(list.size(), 250 + calls);
+
+  // The kept entries are relinked in order in front of the new ones
+  std::vector<int> remaining(list.begin(), list.end());
+  for (int i = 0; i < 250; i++) ASSERT_EQ(remaining[i], 4 * i);
+  for (size_t i = 0; i < calls; i++) ASSERT_EQ(remaining[250 + i], 5000 + static_cast<int>(i));
+
+  // Stopping a sweep keeps the entries that it has not examined
+  ASSERT_EQ(list.sweep_some(10, [](int, uint64_t) { return false; }, [](int) {}), 10u);
+  ASSERT_TRUE(list.sweeping());
+  ASSERT_EQ(list.size(), 240 + calls);
+  list.stop_sweep();
+  ASSERT_FALSE(list.sweeping());
+  remaining.assign(list.begin(), list.end());
+  ASSERT_EQ(remaining.size(), 240 + calls);
+  ASSERT_EQ(remaining.front(), 40);
+
+  // Handing a list off also stops its sweep
+  retire_list<int>::handoff shared;
+  list.sweep_some(1, [](int, uint64_t) { return true; }, [](int) { FAIL(); });
+  list.hand_off(shared);
+  ASSERT_TRUE(list.empty());
+  retire_list<int> other;
+  other.adopt(shared);
+  ASSERT_EQ(other.size(), 240 + calls);
+}
+
+TEST(TestRetireList, HandOffAndAdopt) {
+  retire_list<int>::handoff shared;
+  ASSERT_TRUE(shared.empty());
+
+  retire_list<int> a, b, c;
+  for (int i = 0; i < 300; i++) a.push_back(i);
+  for (int i = 300; i < 500; i++) b.push_back(i);
+  a.hand_off(shared);
+  b.hand_off(shared);
+  ASSERT_TRUE(a.empty());
+  ASSERT_TRUE(b.empty());
+  ASSERT_FALSE(shared.empty());
+
+  c.push_back(-1);
+  c.adopt(shared);
+  ASSERT_TRUE(shared.empty());
+  ASSERT_EQ(c.size(), 501);
+  auto adopted = collect(c.begin(), c.end());
+  ASSERT_EQ(adopted.size(), 501);
+  for (int i = -1; i < 500; i++) ASSERT_EQ(adopted[i + 1], i);
+
+  // The lists that it gave away can still be appended to
+  a.push_back(7);
+  ASSERT_EQ(a.size(), 1);
+  ASSERT_EQ(*a.begin(), 7);
+
+  // Adopted entries that were stamped earlier than the entries in front of them are
+  // ejected as soon as they are old enough
+  retire_list<int> d, e;
+  for (int i = 0; i < 200; i++) d.push_back(i, 5);
+  for (int i = 200; i < 400; i++) e.push_back(i, 1);
+  e.hand_off(shared);
+  d.adopt(shared);
+  std::vector<int> ejected;
+  d.sweep_stamped_before(2, [&](auto first, auto last) { ejected = collect(first, last); });
+  ASSERT_EQ(ejected.size(), 200);
+  ASSERT_EQ(ejected.front(), 200);
+  ASSERT_EQ(d.size(), 200);
+  d.push_back(400, 6);
+  ASSERT_EQ(d.size(), 201);
+  d.sweep_stamped_before(7, [&](auto first, auto last) { ejected = collect(first, last); });
+  ASSERT_EQ(ejected.size(), 201);
+  ASSERT_TRUE(d.empty());
+}
@@ -0,0 +1,124 @@
+// Statistics must be enabled the same way in every translation unit of the program
+#define CDRC_STATS
+
+#include "gtest/gtest.h"
+
+#include <type_traits>
+#include <vector>
+
+#include <cdrc/atomic_rc_ptr.h>
+#include <cdrc/drain.h>
+#include <cdrc/rc_ptr.h>
+#include <cdrc/snapshot_ptr.h>
+#include <cdrc/stats.h>
+
+// A memory management backend together with the guard that
+// must be held while accessing pointers that use it
+template<template<typename> typename Backend, typename Guard>
+struct BackendConfig {
+  template<typename T>
+  using atomic_rc_ptr = cdrc::atomic_rc_ptr<T, Backend<T>>;
+
+  template<typename T>
+  using rc_ptr = cdrc::rc_ptr<T, Backend<T>>;
+
+  template<typename T>
+  using memory_manager = Backend<T>;
+
+  using guard = Guard;
+};
+
+template<typename Config>
+class TestStats : public ::testing::Test { };
+
+using Backends = ::testing::Types<
+  BackendConfig<cdrc::hp_backend, cdrc::empty_guard>,
+  BackendConfig<cdrc::ebr_backend, cdrc::epoch_guard>,
+  BackendConfig<cdrc::ibr_backend, cdrc::epoch_guard>,
+  BackendConfig<cdrc::hyaline_backend, cdrc::hyaline_guard>,
+#if defined(__GCC_HAVE_SYNC_COMPARE_AND_SWAP_16)
+  BackendConfig<cdrc::wfe_backend, cdrc::empty_guard>,
+#endif
+  BackendConfig<cdrc::he_backend, cdrc::empty_guard>
+>;
+
+TYPED_TEST_SUITE(TestStats, Backends);
+
+// Each test uses its own type, so that it starts from memory managers with no statistics
+struct StatsInt {
+  int x;
+  StatsInt(int x_) : x(x_) {}
+};
+
+TYPED_TEST(TestStats, CountsReclamationWork) {
+  using rc_ptr_t = typename TypeParam::template rc_ptr<StatsInt>;
+  using atomic_rc_ptr_t = typename TypeParam::template atomic_rc_ptr<StatsInt>;
+  using memory_manager = typename TypeParam::template memory_manager<StatsInt>;
+  constexpr int N = 10000;
+
+  {
+    atomic_rc_ptr_t ap(rc_ptr_t::make_shared(0));
+    for (int i = 1; i <= N; i++) {
+      [[maybe_unused]] typename TypeParam::guard g;
+      ap.store(rc_ptr_t::make_shared(i));
+    }
+
+    // The object replaced while a snapshot protects it stays deferred, and its retire is
+    // counted although it has not been applied
+    [[maybe_unused]] typename TypeParam::guard g;
+    auto snapshot = ap.get_snapshot();
+    ap.store(rc_ptr_t::make_shared(N + 1));
+    auto s = cdrc::stats<memory_manager>();
+    ASSERT_GE(s.retires, N + 1);
+    ASSERT_GT(s.ejects, 0);
+    ASSERT_GT(s.retires, s.ejects);
+    ASSERT_EQ(snapshot->x, N);
+  }
+  cdrc::drain<memory_manager>();
+
+  auto s = cdrc::stats<memory_manager>();
+  ASSERT_EQ(s.creates, N + 2);
+  ASSERT_GE(s.retires, N + 1);
+  ASSERT_EQ(s.ejects, s.retires);
+  ASSERT_EQ(s.destroys, s.creates);
+  ASSERT_GT(s.deferred_high_water, 0);
+  ASSERT_EQ(s.snapshot_slot_overflows, 0);
+  ASSERT_EQ(s.soft_limit_hits, 0);
+  ASSERT_EQ(s.hard_limit_hits, 0);
+  ASSERT_EQ(atomic_rc_ptr_t::stats().creates, s.creates);
+}
+
+// The backends other than Hyaline scan their deferred actions in passes, and
+// those other than hazard pointers and Hyaline advance an epoch or an era
+TYPED_TEST(TestStats, CountsPassesAndEpochs) {
+  using rc_ptr_t = typename TypeParam::template rc_ptr<int>;
+  using atomic_rc_ptr_t = typename TypeParam::template atomic_rc_ptr<int>;
+  using memory_manager = typename TypeParam::template memory_manager<int>;
+
+  atomic_rc_ptr_t ap(rc_ptr_t::make_shared(0));
+  for (int i = 1; i <= 10000; i++) {
+    [[maybe_unused]] typename TypeParam::guard g;
+    ap.store(rc_ptr_t::make_shared(i));
+  }
+
+  auto s = cdrc::stats<memory_manager>();
+  if constexpr (!std::is_same_v<memory_manager, cdrc::hyaline_backend<int>>) {
+    ASSERT_GT(s.eject_passes, 0);
+    ASSERT_GE(s.scan_ns, s.max_scan_ns);
+    if constexpr (!std::is_same_v<memory_manager, cdrc::hp_backend<int>>) {
+      ASSERT_GT(s.epoch_advances, 0);
+    }
+  }
+}
+
+// Taking more snapshots at once than there are slots falls back to reference counting
+TEST(TestStats, SnapshotSlotOverflows) {
+  using rc_ptr_t = cdrc::rc_ptr<double>;
+  using atomic_rc_ptr_t = cdrc::atomic_rc_ptr<double>;
+  using snapshot_ptr_t = cdrc::snapshot_ptr<double>;
+
+  atomic_rc_ptr_t ap(rc_ptr_t::make_shared(1.0));
+  std::vector<snapshot_ptr_t> snapshots;
+  for (int i = 0; i < 20; i++) snapshots.push_back(ap.get_snapshot());
+  ASSERT_GT(cdrc::stats<cdrc::hp_backend<double>>().snapshot_slot_overflows, 0);
+}
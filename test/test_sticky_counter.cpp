@@ -1,4 +1,9 @@
 #include "gtest/gtest.h"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
 #include <cdrc/internal/utils.h>
 
 using namespace cdrc::utils;
@@ -10,3 +15,86 @@ TEST(TestStickyCounter, Idk) {
   StickyCounter<uint32_t> counter2(1);
   ASSERT_TRUE(counter2.decrement(1));// return true because the decremented to 0
 }
+
+TEST(TestPackedCounter, StrongAndWeakHalves) {
+  PackedStrongAndWeakCounter counter(1);
+  ASSERT_EQ(counter.load_strong(), 1);
+  ASSERT_EQ(counter.load_weak(), 1);
+
+  ASSERT_TRUE(counter.increment_strong(2));
+  ASSERT_TRUE(counter.increment_weak(1));
+  ASSERT_EQ(counter.load_strong(), 3);
+  ASSERT_EQ(counter.load_weak(), 2);
+
+  // The strong count sticks at zero while the weak count remains usable
+  ASSERT_EQ(counter.release_strong(3), StrongRelease::zero);
+  ASSERT_EQ(counter.load_strong(), 0);
+  ASSERT_FALSE(counter.increment_strong(1));
+  ASSERT_EQ(counter.load_strong(), 0);
+  ASSERT_EQ(counter.load_weak(), 2);
+
+  ASSERT_FALSE(counter.decrement_weak(1));
+  ASSERT_TRUE(counter.decrement_weak(1));
+  ASSERT_EQ(counter.load_weak(), 0);
+  ASSERT_FALSE(counter.increment_weak(1));
+}
+
+TEST(TestPackedCounter, LastReleaseWithoutWeakRefs) {
+  PackedStrongAndWeakCounter counter(1);
+  ASSERT_EQ(counter.release_strong(1), StrongRelease::zero_and_no_weak);
+  ASSERT_EQ(counter.load_strong(), 0);
+
+  // Large strong counts do not spill over into the weak count
+  PackedStrongAndWeakCounter counter2(1);
+  ASSERT_TRUE(counter2.increment_strong((uint32_t(1) << 30) - 2));
+  ASSERT_EQ(counter2.load_strong(), (uint32_t(1) << 30) - 1);
+  ASSERT_EQ(counter2.load_weak(), 1);
+  ASSERT_EQ(counter2.release_strong((uint32_t(1) << 30) - 2), StrongRelease::nonzero);
+  ASSERT_EQ(counter2.release_strong(1), StrongRelease::zero_and_no_weak);
+}
+
+// A weak reference holder that tries to revive the object races with the release of
+// its last strong reference. Exactly one of them must win
+TEST(TestPackedCounter, LockRacesWithLastRelease) {
+  for (int i = 0; i < 1000; i++) {
+    PackedStrongAndWeakCounter counter(1);
+    ASSERT_TRUE(counter.increment_weak(1));
+
+    StrongRelease released;
+    bool locked;
+    std::thread releaser([&]() { released = counter.release_strong(1); });
+    std::thread locker([&]() { locked = counter.increment_strong(1); });
+    releaser.join();
+    locker.join();
+
+    ASSERT_NE(released, StrongRelease::zero_and_no_weak);
+    ASSERT_NE(locked, released == StrongRelease::zero);
+    ASSERT_EQ(counter.load_strong(), locked ? 1 : 0);
+  }
+}
+
+// Exposes the two steps of release_strong, so that other operations can run between them
+struct SteppedPackedCounter : PackedStrongAndWeakCounter {
+  using PackedStrongAndWeakCounter::PackedStrongAndWeakCounter;
+  using PackedStrongAndWeakCounter::begin_release_strong;
+  using PackedStrongAndWeakCounter::finish_release_strong;
+};
+
+// A weak reference holder sees the strong count at zero and then fails to revive the object
+// between the decrement of the last strong reference and the check of its outcome. The load
+// sets the zero_pending flag and the failed increment then adds to the zero count, but the
+// release must still find that it hit zero
+TEST(TestPackedCounter, FailedLockBetweenLastReleaseSteps) {
+  for (uint32_t failed_locks : {0, 1, 5}) {
+    SteppedPackedCounter counter(1);
+    ASSERT_TRUE(counter.increment_weak(1));
+
+    auto old = counter.begin_release_strong(1);
+    ASSERT_EQ(counter.load_strong(), 0);
+    for (uint32_t i = 0; i < failed_locks; i++) ASSERT_FALSE(counter.increment_strong(1));
+    ASSERT_EQ(counter.finish_release_strong(1, old), StrongRelease::zero);
+    ASSERT_EQ(counter.load_strong(), 0);
+    ASSERT_FALSE(counter.increment_strong(1));
+    ASSERT_EQ(counter.load_weak(), 2);
+  }
+}
@@ -0,0 +1,49 @@
+#include "gtest/gtest.h"
+
+#include <thread>
+#include <vector>
+
+#include <cdrc/rc_ptr.h>
+#include <cdrc/internal/utils.h>
+
+using namespace cdrc::utils;
+
+TEST(TestThreadRegistry, ReuseIds) {
+  threadID.getTID();  // register the main thread
+  size_t before = num_thread_ids();
+  for (int i = 0; i < 100; i++) {
+    std::thread t([]() { threadID.getTID(); });
+    t.join();
+  }
+  // Sequential threads should recycle the same id
+  ASSERT_LE(num_thread_ids(), before + 1);
+}
+
+TEST(TestThreadRegistry, GrowBeyondHint) {
+  size_t n = 4 * num_threads() + 3;
+  std::vector<std::thread> threads;
+  std::atomic<size_t> ready{0};
+  std::atomic<bool> go{false};
+  for (size_t i = 0; i < n; i++) {
+    threads.emplace_back([&]() {
+      auto p = cdrc::rc_ptr<int>::make_shared(threadID.getTID());
+      ready++;
+      while (!go) std::this_thread::yield();
+      for (int j = 0; j < 100; j++) {
+        auto q = p;
+        p = cdrc::rc_ptr<int>::make_shared(*q + 1);
+      }
+    });
+  }
+  while (ready < n) std::this_thread::yield();
+  ASSERT_GE(num_thread_ids(), n);
+  go = true;
+  for (auto& t : threads) t.join();
+}
+
+TEST(TestThreadRegistry, PerThreadArray) {
+  PerThreadArray<size_t> arr;
+  size_t n = 10 * num_threads();
+  for (size_t i = 0; i < n; i++) arr[i] = i;
+  for (size_t i = 0; i < n; i++) ASSERT_EQ(arr[i], i);
+}